@@ -0,0 +1,50 @@
+#include "crypto.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Measures throughput of raw buffer encryption and decryption for every cipher available on this device.
+int main() {
+    electronpass::Crypto crypto("password");
+    if (!crypto.check()) return 1;
+
+    const size_t sizes[] = {1024, 64 * 1024, 16 * 1024 * 1024};
+    const electronpass::Cipher ciphers[] = {electronpass::Cipher::CHACHA20_POLY1305,
+                                            electronpass::Cipher::XCHACHA20_POLY1305,
+                                            electronpass::Cipher::AES256_GCM};
+    const char *names[] = {"ChaCha20-Poly1305", "XChaCha20-Poly1305", "AES-256-GCM"};
+
+    std::printf("%-20s %10s %12s %12s\n", "cipher", "size", "enc MB/s", "dec MB/s");
+    for (size_t i = 0; i < sizeof(ciphers) / sizeof(ciphers[0]); ++i) {
+        if (!electronpass::Crypto::cipher_available(ciphers[i])) {
+            std::printf("%-20s not available\n", names[i]);
+            continue;
+        }
+
+        for (size_t size : sizes) {
+            std::vector<unsigned char> plain(size, 'a');
+            std::vector<unsigned char> cipher(electronpass::Crypto::cipher_text_size(size, ciphers[i]));
+            const size_t rounds = 256 * 1024 * 1024 / size;
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                crypto.encrypt(plain.data(), plain.size(), cipher.data(), cipher.size(), NULL, 0, ciphers[i]);
+            }
+            const double enc_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                if (!crypto.decrypt(cipher.data(), cipher.size(), plain.data(), plain.size(), NULL, 0, ciphers[i])) {
+                    return 1;
+                }
+            }
+            const double dec_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            const double mb = static_cast<double>(size) * rounds / (1024 * 1024);
+            std::printf("%-20s %10zu %12.1f %12.1f\n", names[i], size, mb / enc_s, mb / dec_s);
+        }
+    }
+
+    return 0;
+}
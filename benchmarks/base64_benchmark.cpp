@@ -0,0 +1,89 @@
+#include "crypto.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cctype>
+#include <string>
+#include <functional>
+
+// Compares throughput of Crypto::base64_encode() and Crypto::base64_decode() with the previous implementation, which
+// appended one character at a time and searched BASE64_CHARS for every decoded character.
+namespace {
+    std::string reference_encode(const std::string& s) {
+        std::string result;
+        size_t i = 0;
+        unsigned char chars[3];
+        for (size_t n = 0; n < s.size(); ++n) {
+            chars[i++] = static_cast<unsigned char>(s[n]);
+            if (i == 3) {
+                result += electronpass::BASE64_CHARS[(chars[0] & 0xfc) >> 2];
+                result += electronpass::BASE64_CHARS[((chars[0] & 0x03) << 4) + ((chars[1] & 0xf0) >> 4)];
+                result += electronpass::BASE64_CHARS[((chars[1] & 0x0f) << 2) + ((chars[2] & 0xc0) >> 6)];
+                result += electronpass::BASE64_CHARS[chars[2] & 0x3f];
+                i = 0;
+            }
+        }
+        if (i) {
+            for (size_t j = i; j < 3; ++j) chars[j] = 0;
+            const unsigned char indices[3] = {
+                static_cast<unsigned char>((chars[0] & 0xfc) >> 2),
+                static_cast<unsigned char>(((chars[0] & 0x03) << 4) + ((chars[1] & 0xf0) >> 4)),
+                static_cast<unsigned char>(((chars[1] & 0x0f) << 2) + ((chars[2] & 0xc0) >> 6))
+            };
+            for (size_t j = 0; j < i + 1; ++j) result += electronpass::BASE64_CHARS[indices[j]];
+            while (i++ < 3) result += '=';
+        }
+        return result;
+    }
+
+    std::string reference_decode(const std::string& s) {
+        if (s.size() % 4 != 0) return "";
+        std::string result;
+        size_t i = 0, n = 0;
+        unsigned char chars[4];
+        while (n < s.size() && s[n] != '=' && (std::isalnum(s[n]) || s[n] == '+' || s[n] == '/')) {
+            chars[i++] = static_cast<unsigned char>(electronpass::BASE64_CHARS.find(s[n++]));
+            if (i == 4) {
+                result += static_cast<char>((chars[0] << 2) + ((chars[1] & 0x30) >> 4));
+                result += static_cast<char>(((chars[1] & 0x0f) << 4) + ((chars[2] & 0x3c) >> 2));
+                result += static_cast<char>(((chars[2] & 0x03) << 6) + chars[3]);
+                i = 0;
+            }
+        }
+        if (i) {
+            for (size_t j = i; j < 4; ++j) chars[j] = 0;
+            result += static_cast<char>((chars[0] << 2) + ((chars[1] & 0x30) >> 4));
+            if (i > 2) result += static_cast<char>(((chars[1] & 0x0f) << 4) + ((chars[2] & 0x3c) >> 2));
+        }
+        return result;
+    }
+
+    // Returns MB/s of running function over data of given size.
+    double measure(const std::function<void()>& function, size_t bytes) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return bytes / seconds / (1024 * 1024);
+    }
+}
+
+int main() {
+    std::string data(64 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>(i * 131 + (i >> 8));
+
+    const std::string encoded = electronpass::Crypto::base64_encode(data);
+    if (reference_encode(data) != encoded || electronpass::Crypto::base64_decode(encoded) != data ||
+        reference_decode(encoded) != data) {
+        return 1;
+    }
+
+    std::string output;
+    std::printf("%12s %14s %14s\n", "", "encode MB/s", "decode MB/s");
+    std::printf("%12s %14.1f %14.1f\n", "reference",
+                measure([&]() { output = reference_encode(data); }, data.size()),
+                measure([&]() { output = reference_decode(encoded); }, data.size()));
+    std::printf("%12s %14.1f %14.1f\n", "Crypto",
+                measure([&]() { output = electronpass::Crypto::base64_encode(data); }, data.size()),
+                measure([&]() { output = electronpass::Crypto::base64_decode(encoded); }, data.size()));
+
+    return 0;
+}
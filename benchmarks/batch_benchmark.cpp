@@ -0,0 +1,58 @@
+#include "crypto.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <vector>
+
+// Measures how many small messages per second encrypt_many() and decrypt_many() process and throughput of
+// segmented encryption with different number of threads.
+int main() {
+    electronpass::Crypto crypto("password");
+    if (!crypto.check()) return 1;
+
+    const std::vector<std::string> messages(100000, std::string(200, 'a'));
+    const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%8s %14s %14s\n", "threads", "enc msg/s", "dec msg/s");
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        bool ok;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> encrypted = crypto.encrypt_many(messages, ok, threads);
+        const double enc_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) return 1;
+
+        std::vector<bool> success;
+        start = std::chrono::steady_clock::now();
+        crypto.decrypt_many(encrypted, success, threads);
+        const double dec_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%8u %14.0f %14.0f\n", threads, messages.size() / enc_s, messages.size() / dec_s);
+    }
+
+    const electronpass::Cipher cipher = electronpass::Crypto::preferred_cipher();
+    std::vector<unsigned char> plain(256 * 1024 * 1024, 'a');
+    std::vector<unsigned char> encrypted(electronpass::Crypto::segmented_cipher_text_size(plain.size(), cipher));
+
+    std::printf("\n%8s %14s %14s\n", "threads", "enc MB/s", "dec MB/s");
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        if (!crypto.encrypt_segmented(plain.data(), plain.size(), encrypted.data(), encrypted.size(),
+                                      NULL, 0, cipher, threads)) {
+            return 1;
+        }
+        const double enc_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        if (!crypto.decrypt_segmented(encrypted.data(), encrypted.size(), plain.data(), plain.size(),
+                                      NULL, 0, cipher, threads)) {
+            return 1;
+        }
+        const double dec_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%8u %14.1f %14.1f\n", threads, 256 / enc_s, 256 / dec_s);
+    }
+
+    return 0;
+}
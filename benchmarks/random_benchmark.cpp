@@ -0,0 +1,38 @@
+#include "random.hpp"
+#include "passwords.hpp"
+#include <sodium.h>
+#include <chrono>
+#include <cstdio>
+
+// Compares cost of random values from Random with libsodium's system random, which Random is seeded from.
+namespace {
+    template <typename Function>
+    double nanoseconds_per_call(Function function, int calls) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) function();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    }
+}
+
+int main() {
+    if (sodium_init() == -1) return 1;
+
+    const int calls = 1000000;
+    volatile uint32_t sink = 0;
+    unsigned char nonce[24];
+
+    std::printf("%28s %10s\n", "", "ns/call");
+    std::printf("%28s %10.1f\n", "randombytes_uniform(62)",
+                nanoseconds_per_call([&]() { sink = randombytes_uniform(62); }, calls));
+    std::printf("%28s %10.1f\n", "Random::uniform(62)",
+                nanoseconds_per_call([&]() { sink = electronpass::Random::uniform(62); }, calls));
+    std::printf("%28s %10.1f\n", "randombytes_buf(24)",
+                nanoseconds_per_call([&]() { randombytes_buf(nonce, sizeof nonce); }, calls));
+    std::printf("%28s %10.1f\n", "Random::bytes(24)",
+                nanoseconds_per_call([&]() { electronpass::Random::bytes(nonce, sizeof nonce); }, calls));
+    std::printf("%28s %10.1f\n", "generate_random_pass(32)",
+                nanoseconds_per_call([]() { electronpass::passwords::generate_random_pass(32); }, calls / 100));
+    (void) sink;
+
+    return 0;
+}
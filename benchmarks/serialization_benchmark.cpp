@@ -0,0 +1,106 @@
+#include "serialization.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/resource.h>
+
+// Measures time and peak memory of deserializing and serializing a wallet with many items, and time and size of
+// saving and loading it with each compression and
+// through a file.
+namespace {
+    // Peak resident memory of the process in KiB.
+    long peak_memory() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+}
+
+int main() {
+    const int item_count = 50000;
+
+    // JSON is written by hand, so building it doesn't raise peak memory more than the string itself.
+    std::string json = "{\"items\":{";
+    for (int i = 0; i < item_count; ++i) {
+        if (i > 0) json += ",";
+        json += "\"" + electronpass::ItemId::generate().to_string() + "\":{\"fields\":["
+                "{\"name\":\"Username\",\"sensitive\":false,\"type\":\"username\",\"value\":\"user" + std::to_string(i) + "\"},"
+                "{\"name\":\"Password\",\"sensitive\":true,\"type\":\"password\",\"value\":\"password" + std::to_string(i) + "\"},"
+                "{\"name\":\"Website\",\"sensitive\":false,\"type\":\"url\",\"value\":\"https://example.com/" + std::to_string(i) + "\"}"
+                "],\"last_edited\":1493189705,\"name\":\"Item " + std::to_string(i) + "\"}";
+    }
+    json += "}}";
+
+    const long memory_before = peak_memory();
+    const auto start = std::chrono::steady_clock::now();
+    electronpass::Wallet wallet = electronpass::serialization::deserialize(json);
+    const double deserialize_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (wallet.size() != static_cast<unsigned long>(item_count)) return 1;
+
+    const long deserialize_memory = peak_memory() - memory_before;
+    json.clear();
+    json.shrink_to_fit();
+
+    const long serialize_memory_before = peak_memory();
+    auto serialize_start = std::chrono::steady_clock::now();
+    const std::string serialized = electronpass::serialization::serialize(wallet);
+    const double serialize_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - serialize_start).count();
+    const long serialize_memory = peak_memory() - serialize_memory_before;
+
+    std::printf("%8s %8s %16s %10s %14s %10s\n", "items", "JSON MB", "deserialize ms", "peak +MB",
+                "serialize ms", "peak +MB");
+    std::printf("%8d %8.1f %16.1f %10.1f %14.1f %10.1f\n\n", item_count, serialized.size() / 1e6,
+                deserialize_s * 1e3, deserialize_memory / 1024.0, serialize_s * 1e3, serialize_memory / 1024.0);
+
+    electronpass::Crypto crypto("password");
+    if (!crypto.check()) return 1;
+
+    using electronpass::serialization::Compression;
+    const char *names[] = {"none", "lz", "zlib"};
+    std::printf("%12s %10s %10s %10s\n", "compression", "saved MB", "save ms", "load ms");
+    for (Compression compression : {Compression::NONE, Compression::LZ, Compression::ZLIB}) {
+        if (!electronpass::serialization::compression_available(compression)) continue;
+
+        int error;
+        const auto save_start = std::chrono::steady_clock::now();
+        const std::string saved = electronpass::serialization::save(wallet, crypto, error, compression);
+        const double save_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - save_start).count();
+        if (error != 0) return 1;
+
+        const auto load_start = std::chrono::steady_clock::now();
+        electronpass::serialization::load(saved, crypto, error);
+        const double load_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+        if (error != 0) return 1;
+
+        std::printf("%12s %10.1f %10.1f %10.1f\n", names[static_cast<int>(compression)], saved.size() / 1e6,
+                    save_s * 1e3, load_s * 1e3);
+    }
+
+    // Saving to and loading from a file, compared with reading the file into a string first.
+    const char *path = "serialization_benchmark.epwl";
+    int error;
+    auto file_start = std::chrono::steady_clock::now();
+    electronpass::serialization::save_file(wallet, crypto, path, error);
+    const double save_file_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - file_start).count();
+    if (error != 0) return 1;
+
+    file_start = std::chrono::steady_clock::now();
+    electronpass::serialization::load_file(path, crypto, error);
+    const double load_file_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - file_start).count();
+    if (error != 0) return 1;
+
+    file_start = std::chrono::steady_clock::now();
+    std::ifstream in(path, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    electronpass::serialization::load(data, crypto, error);
+    const double load_string_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - file_start).count();
+    std::remove(path);
+    if (error != 0) return 1;
+
+    std::printf("\n%14s %14s %20s\n", "save_file ms", "load_file ms", "read + load ms");
+    std::printf("%14.1f %14.1f %20.1f\n", save_file_s * 1e3, load_file_s * 1e3, load_string_s * 1e3);
+
+    return 0;
+}
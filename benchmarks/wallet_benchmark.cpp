@@ -0,0 +1,39 @@
+#include "wallet.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures adding, listing and looking up items in a wallet with many items.
+int main() {
+    const int item_count = 100000;
+
+    std::vector<electronpass::Wallet::Item> items;
+    items.reserve(item_count);
+    for (int i = 0; i < item_count; ++i) items.push_back(electronpass::Wallet::Item("item"));
+
+    electronpass::Wallet wallet;
+    auto start = std::chrono::steady_clock::now();
+    for (const electronpass::Wallet::Item& item : items) wallet.add_item(item);
+    const double add_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    std::vector<std::string> ids = wallet.get_ids();
+    const double ids_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Items are looked up in random order, as they would be by a user.
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+    start = std::chrono::steady_clock::now();
+    unsigned long found = 0;
+    for (const std::string& id : ids) found += wallet[id].name.size();
+    const double lookup_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (found != ids.size() * 4) return 1;
+
+    std::printf("%12s %12s %12s\n", "add ns", "get_ids ns", "lookup ns");
+    std::printf("%12.0f %12.0f %12.0f\n", add_s * 1e9 / item_count, ids_s * 1e9 / item_count,
+                lookup_s * 1e9 / item_count);
+
+    return 0;
+}
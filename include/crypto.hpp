@@ -20,8 +20,19 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <sodium.h>
 #include <string>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <future>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <chrono>
 #include <cassert>
 
+#include "secure_memory.hpp"
+
 /**
  * @file crypto.hpp
  * @author Matej Marinko <matejmarinko123@gmail.com>
@@ -32,7 +43,7 @@ namespace electronpass {
     //// All chars in Base64.
     static const std::string BASE64_CHARS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-    // Salt used for generating encryption keys.
+    // Salt used for generating encryption keys of legacy wallets. New wallets use a random salt (see KdfParams).
     static const unsigned char CRYPTO_SALT[crypto_pwhash_scryptsalsa208sha256_SALTBYTES] = {  // 32 bytes
         0xf4, 0x78, 0x2a, 0x93, 0x4c, 0x56, 0xb8, 0xd9,
         0xfb, 0x66, 0xca, 0xb6, 0x43, 0x31, 0xb8, 0xd9,
@@ -40,26 +51,558 @@ namespace electronpass {
         0xfb, 0x90, 0xca, 0x02, 0x4c, 0x31, 0xa6, 0x11
     };
 
+    class Crypto;
+    class KeyDerivation;
+    class QuickUnlock;
+    class IncrementalDecryptor;
+
+    /**
+     * @brief Authenticated encryption algorithms, that Crypto supports.
+     *
+     * - CHACHA20_POLY1305: original ChaCha20-Poly1305 with 8 bytes nonce, used by legacy wallets and
+     * Crypto::encrypt(const std::string&, bool&)
+     * - XCHACHA20_POLY1305: XChaCha20-Poly1305 with 24 bytes nonce, available everywhere
+     * - AES256_GCM: AES-256-GCM with 12 bytes nonce, much faster, but only available on CPUs with hardware AES
+     * support (see Crypto::cipher_available())
+     *
+     * Values are stored in saved wallets, so they must not change. Value 1 is used by wallets saved to a stream.
+     */
+    enum class Cipher : uint8_t {
+        CHACHA20_POLY1305 = 0, XCHACHA20_POLY1305 = 2, AES256_GCM = 3
+    };
+
+    /**
+     * @brief Parameters for deriving encryption key from password.
+     *
+     * Parameters are stored in the header of every saved wallet, so each wallet can use its own random salt and
+     * a cost, which suits the device it was created on. When opening a wallet, read its parameters with
+     * serialization::kdf_params() and use them for creating Crypto.
+     */
+    struct KdfParams {
+        /// Key derivation algorithm. Values are stored in saved wallets, so they must not change.
+        enum class Algorithm : uint8_t {
+            SCRYPT = 0, ARGON2ID = 1
+        };
+
+        /**
+         * @brief Predefined costs of key derivation.
+         *
+         * - INTERACTIVE: for unlocking on low-end devices (Argon2id: 64 MiB of memory)
+         * - MODERATE: for unlocking on desktop computers (Argon2id: 256 MiB of memory)
+         * - SENSITIVE: when unlocking can take a few seconds (Argon2id: 1 GiB of memory)
+         */
+        enum class Profile {
+            INTERACTIVE, MODERATE, SENSITIVE
+        };
+
+        /// Key derivation algorithm.
+        Algorithm algorithm = Algorithm::ARGON2ID;
+        /// Number of computations, that key derivation performs.
+        uint64_t opslimit = 0;
+        /// Maximum amount of memory in bytes, that key derivation uses.
+        uint64_t memlimit = 0;
+        /// Random salt, unique for each wallet.
+        std::string salt;
+
+        /**
+         * @brief Parameters, that were used before they were stored in wallets.
+         *
+         * Scrypt with interactive limits and constant CRYPTO_SALT. Used for legacy wallets and by
+         * Crypto(std::string).
+         */
+        static KdfParams legacy();
+
+        /**
+         * @brief Generates parameters for a new wallet.
+         * @param profile Cost of key derivation.
+         * @return Argon2id parameters with given cost and random salt. If libsodium can't be initialized, parameters
+         * have no salt and are not valid().
+         */
+        static KdfParams generate(Profile profile = Profile::INTERACTIVE);
+
+        /**
+         * @brief Checks if parameters can be used for key derivation.
+         *
+         * Parameters read from a wallet are untrusted, so besides supported algorithm and salt size, this also
+         * limits memory usage to the SENSITIVE profile.
+         *
+         * @return True if parameters are valid, otherwise false.
+         */
+        bool valid() const;
+
+        /// Compares all parameters.
+        bool operator==(const KdfParams& other) const;
+
+        /// Compares all parameters.
+        bool operator!=(const KdfParams& other) const;
+    };
+
+    /**
+     * @brief Encryption key, derived from password.
+     *
+     * Deriving key from password is intentionally slow. DerivedKey allows doing it only once and then constructing
+     * Crypto objects with Crypto(const DerivedKey&), which doesn't run key derivation again.
+     *
+     * DerivedKey also holds random data keys, which encrypt wallets and are stored wrapped with the key derived from
+     * password (see Crypto::generate_data_key()).
+     *
+     * Key is stored in memory allocated with libsodium's guarded allocation. It is locked (so it isn't swapped to
+     * disk), inaccessible while not in use and wiped when DerivedKey is destroyed.
+     *
+     * DerivedKey can be moved, but not copied. Use Crypto::derive_key() to create it.
+     */
+    class DerivedKey {
+        friend class Crypto;
+        friend class KeyDerivation;
+        friend class QuickUnlock;
+
+        // Protected memory with key. NULL if key derivation failed or if key was moved.
+        unsigned char *key;
+        KdfParams params;
+
+        DerivedKey(unsigned char *key_, const KdfParams& params_);
+
+      public:
+        /// Move constructor. Key is moved and other is left without key.
+        DerivedKey(DerivedKey&& other);
+
+        /// Move assignment. Current key is wiped and replaced with key from other.
+        DerivedKey& operator=(DerivedKey&& other);
+
+        DerivedKey(const DerivedKey&) = delete;
+        DerivedKey& operator=(const DerivedKey&) = delete;
+
+        /// Destructor, which wipes the key.
+        ~DerivedKey();
+
+        /**
+         * @brief Checks if key was successfully derived.
+         * @returns false if key derivation failed or if key was moved to another object, otherwise true.
+         */
+        bool check() const;
+
+        /**
+         * @brief Parameters, that were used for deriving the key.
+         *
+         * Random keys (eg. from Crypto::generate_data_key()) were not derived from a password, so their parameters
+         * are empty (KdfParams()), which are never valid() and never equal to parameters of a password.
+         *
+         * @return Key derivation parameters.
+         */
+        const KdfParams& kdf_params() const;
+    };
+
+    /**
+     * @brief Handle for key derivation, running on a worker thread.
+     *
+     * Returned by Crypto::derive_async(). All derivations run one at a time on a single worker thread. Key derivation
+     * itself can't be interrupted, but cancelled derivation will not start if it is still waiting to start and its
+     * key will be wiped as soon as it is derived instead of being delivered. At most one derivation waits to start:
+     * a newer one supersedes it and the waiting one is cancelled. This way derivation for an outdated password (eg.
+     * when user retypes it) is dropped.
+     *
+     * Destroying the handle doesn't wait for or cancel the derivation.
+     */
+    class KeyDerivation {
+        friend class Crypto;
+
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::shared_future<void> finished;
+        std::shared_ptr<DerivedKey> result;
+
+        KeyDerivation();
+
+      public:
+        /// Cancels derivation. Callback will not be called and get() will return invalid key.
+        void cancel();
+
+        /**
+         * @brief Checks if derivation was cancelled.
+         * @return True if cancel() was called, otherwise false.
+         */
+        bool is_cancelled() const;
+
+        /**
+         * @brief Checks if derivation has finished, without blocking.
+         * @return True if key was derived (or derivation was dropped after cancel()), otherwise false.
+         */
+        bool ready() const;
+
+        /// Blocks until derivation finishes.
+        void wait() const;
+
+        /**
+         * @brief Waits for derivation to finish and returns derived key.
+         *
+         * Key can be taken only once. Following calls (and calls after a callback has received the key)
+         * return invalid key.
+         *
+         * @return Derived key. Invalid if derivation failed or was cancelled.
+         */
+        DerivedKey get();
+    };
+
+    /**
+     * @brief Key sealed in memory under a short PIN, so a locked wallet can be unlocked again quickly.
+     *
+     * After the wallet is unlocked with the master password, its key is encrypted with a key derived from the PIN
+     * with a cheap key derivation (milliseconds instead of full memory-hard derivation). Unlocking with the PIN gives
+     * back the original key. Session ends and sealed key is wiped when:
+     * - the PIN is entered wrong max_attempts times in a row,
+     * - timeout passes since the session was created or last unlocked,
+     * - lock() is called.
+     *
+     * After that, master password is needed again. PIN is short, so sealed key must never leave memory; it is only
+     * protected against repeated guessing through this class.
+     *
+     * QuickUnlock can be moved, but not copied (copies would have their own attempt counters). It is not thread-safe.
+     */
+    class QuickUnlock {
+        // Key, wrapped with the key derived from PIN (see Crypto::wrap_key()). Empty when session has ended.
+        SecureBuffer sealed;
+        // Parameters of the sealed key.
+        KdfParams params;
+        // Parameters for deriving key from PIN.
+        KdfParams pin_params;
+        unsigned int max_attempts;
+        unsigned int remaining_attempts;
+        std::chrono::steady_clock::duration timeout;
+        std::chrono::steady_clock::time_point deadline;
+
+      public:
+        /**
+         * @brief Starts quick unlock session.
+         * @param key Key of unlocked wallet. It is not changed.
+         * @param pin PIN for unlocking.
+         * @param timeout Time after which session ends, if wallet isn't unlocked.
+         * @param max_attempts Number of wrong PINs, after which session ends.
+         */
+        QuickUnlock(const DerivedKey& key, const std::string& pin,
+                    std::chrono::seconds timeout = std::chrono::seconds(300), unsigned int max_attempts = 3);
+
+        /// Move constructor.
+        QuickUnlock(QuickUnlock&& other) = default;
+
+        /// Move assignment. Current sealed key is wiped and replaced with the one from other.
+        QuickUnlock& operator=(QuickUnlock&& other);
+
+        QuickUnlock(const QuickUnlock&) = delete;
+        QuickUnlock& operator=(const QuickUnlock&) = delete;
+
+        /// Destructor, which wipes sealed key.
+        ~QuickUnlock();
+
+        /**
+         * @brief Unseals the key with PIN.
+         *
+         * Successful unlock resets number of attempts and timeout. Wrong PIN uses one attempt.
+         *
+         * @param pin PIN, that was used for creating the session.
+         * @return Original key. Invalid if PIN is wrong or session has ended.
+         */
+        DerivedKey unlock(const std::string& pin);
+
+        /// Ends session and wipes sealed key.
+        void lock();
+
+        /**
+         * @brief Wipes sealed key if timeout has passed.
+         *
+         * Timeout is otherwise only enforced by unlock(), so calling this periodically (eg. from a timer) makes sure
+         * the sealed key doesn't stay in memory after the session has ended.
+         *
+         * @return True if session is still active, otherwise false.
+         */
+        bool lock_if_expired();
+
+        /**
+         * @brief Checks if session is still active. Doesn't wipe the key of an expired session (see lock_if_expired()).
+         * @return True if key can still be unlocked with PIN, otherwise false.
+         */
+        bool active() const;
+
+        /**
+         * @brief Number of wrong PINs, that will still be accepted before session ends.
+         * @return Remaining attempts, 0 if session has ended.
+         */
+        unsigned int attempts_left() const;
+    };
+
     /// Class for cryptographics functions and helper functions.
     class Crypto {
+        friend class IncrementalDecryptor;
+
       private:
 
         // Key for encryption
         unsigned char key[crypto_box_SEEDBYTES];  // 32 bytes
         // if key was generated from password, if libsodium init was successful
         bool sodium_success = false;
+        // Parameters, with which key was generated.
+        KdfParams params;
+        // Cipher used for saving wallets. It must be available on every device, so wallets can be synced anywhere.
+        Cipher wallet_cipher = Cipher::XCHACHA20_POLY1305;
+
+        // Generates key from password with given key derivation parameters.
+        static bool generate_key(const char *password, size_t password_len, const KdfParams& params,
+                                 unsigned char *key);
+        // Same as derive_key(const std::string&, const KdfParams&), but password can be in any buffer.
+        static DerivedKey derive_key(const char *password, size_t password_len, const KdfParams& kdf_params);
 
-        // Generates key from sha256 hash of password.
-        bool generate_key(const char *password, unsigned int pass_len);
+        // Encrypts plain text with given nonce. Encrypted data and authentication tag are written to encrypted.
+        bool aead_encrypt(const unsigned char *plain_text, size_t plain_text_len, unsigned char *encrypted,
+                          const unsigned char *additional_data, size_t additional_data_len,
+                          const unsigned char *nonce, Cipher cipher) const;
+        // Decrypts data encrypted with aead_encrypt().
+        bool aead_decrypt(const unsigned char *encrypted, size_t encrypted_len, unsigned char *plain_text,
+                          const unsigned char *additional_data, size_t additional_data_len,
+                          const unsigned char *nonce, Cipher cipher) const;
 
       public:
 
         /**
          * @brief Constructor
+         *
+         * Key is generated with KdfParams::legacy() parameters.
+         *
          * @param password Password, from which encryption key will be generated.
          */
         Crypto(std::string password);
 
+        /**
+         * @brief Constructor with custom key derivation parameters.
+         * @param password Password, from which encryption key will be generated.
+         * @param kdf_params Key derivation parameters. If they are not valid, check() will return false.
+         */
+        Crypto(const std::string& password, const KdfParams& kdf_params);
+
+        /**
+         * @brief Constructor, which uses already derived key.
+         *
+         * Key derivation is not run again, so this constructor is fast. Use it for creating short-lived Crypto
+         * objects for the same password.
+         *
+         * @param derived_key Key, derived with derive_key(). If it is not valid, check() will return false.
+         */
+        Crypto(const DerivedKey& derived_key);
+
+        /// Destructor, which wipes the key.
+        ~Crypto();
+
+        /**
+         * @brief Parameters, that were used for generating the key.
+         * @return Key derivation parameters.
+         */
+        const KdfParams& kdf_params() const;
+
+        /**
+         * @brief Finds the strongest Argon2id parameters, that derive a key within given time on this device.
+         *
+         * Key derivation is timed on the current machine. Memory is preferred over number of passes, because it makes
+         * attacks with specialized hardware more expensive: all of max_mem is used if a single pass fits into target
+         * time, otherwise memory is halved until it does. Remaining time is then filled with additional passes. If
+         * key derivation fails (eg. because memory can't be allocated), memory is halved as well.
+         *
+         * Calibration runs key derivation a few times, so it takes a few multiples of target_ms.
+         *
+         * @param target_ms Wanted duration of key derivation in milliseconds.
+         * @param max_mem Maximum amount of memory in bytes, that key derivation can use. It is limited to the memory
+         * of KdfParams::Profile::SENSITIVE.
+         * @return Parameters with random salt. Check KdfParams::valid() to see if calibration was successful. They are
+         * only invalid if key derivation fails even with the minimum memory.
+         */
+        static KdfParams calibrate_kdf(unsigned int target_ms, uint64_t max_mem);
+
+        /**
+         * @brief Derives encryption key from password.
+         *
+         * Key is the same as the one, that Crypto(const std::string&, const KdfParams&) generates from the same
+         * password and parameters.
+         *
+         * @param password Password, from which encryption key will be generated.
+         * @param kdf_params Key derivation parameters.
+         * @return Derived key. Check DerivedKey::check() to see if derivation was successful.
+         */
+        static DerivedKey derive_key(const std::string& password, const KdfParams& kdf_params = KdfParams::legacy());
+
+        /**
+         * @brief Derives encryption key from password on a worker thread.
+         *
+         * Calling thread is not blocked. Key is the same as the one derive_key() returns. Password is copied to
+         * secure memory, which is wiped when derivation finishes. If another derivation is still waiting to start,
+         * it is cancelled (see KeyDerivation).
+         *
+         * @param password Password, from which encryption key will be generated.
+         * @param callback Optional function, that is called on the worker thread with derived key, unless derivation
+         * is cancelled before it finishes. If callback is set, KeyDerivation::get() returns invalid key.
+         * @return Handle for waiting for and cancelling the derivation.
+         */
+        static KeyDerivation derive_async(const std::string& password,
+                                          std::function<void(DerivedKey)> callback = nullptr);
+
+        /**
+         * @brief Derives encryption key from password with given parameters on a worker thread.
+         *
+         * Same as derive_async(const std::string&, std::function<void(DerivedKey)>), but key is derived with
+         * given parameters instead of KdfParams::legacy().
+         *
+         * @param password Password, from which encryption key will be generated.
+         * @param kdf_params Key derivation parameters.
+         * @param callback Optional function, that is called on the worker thread with derived key.
+         * @return Handle for waiting for and cancelling the derivation.
+         */
+        static KeyDerivation derive_async(const std::string& password, const KdfParams& kdf_params,
+                                          std::function<void(DerivedKey)> callback = nullptr);
+
+        /**
+         * @brief Generates random key for encrypting wallet data.
+         *
+         * Wallet is encrypted with a random data key, which is stored in the wallet wrapped (encrypted) with the key
+         * derived from password. Changing password then only needs to wrap the data key again, instead of
+         * encrypting the whole wallet again.
+         *
+         * @return Random key with empty key derivation parameters (see DerivedKey::kdf_params()). Check
+         * DerivedKey::check() to see if it was generated.
+         */
+        DerivedKey generate_data_key() const;
+
+        /**
+         * @brief Generates random key, which doesn't belong to any password (eg. key of items shared with
+         * sharing::share()).
+         * @return Random key. Check DerivedKey::check() to see if it was generated.
+         */
+        static DerivedKey generate_random_key();
+
+        /**
+         * @brief Encrypts data key with the key of this object.
+         *
+         * Data key is encrypted with XChaCha20-Poly1305. Output is random nonce, followed by encrypted key and
+         * authentication tag.
+         *
+         * @param data_key Key, which will be wrapped.
+         * @param wrapped Output buffer of WRAPPED_KEY_BYTES bytes.
+         * @param additional_data Data, which is authenticated together with the key, but not encrypted. Can be NULL.
+         * @param additional_data_len Length of additional data in bytes.
+         * @return True if key was wrapped, false otherwise.
+         */
+        bool wrap_key(const DerivedKey& data_key, unsigned char *wrapped,
+                      const unsigned char *additional_data = NULL, size_t additional_data_len = 0) const;
+
+        /**
+         * @brief Decrypts data key, that was wrapped with wrap_key().
+         * @param wrapped Wrapped key.
+         * @param wrapped_len Length of wrapped key in bytes. Must be WRAPPED_KEY_BYTES.
+         * @param additional_data Additional data, that was used for wrapping. Can be NULL.
+         * @param additional_data_len Length of additional data in bytes.
+         * @return Data key with empty key derivation parameters (see DerivedKey::kdf_params()). Invalid if password was
+         * wrong or data was changed.
+         */
+        DerivedKey unwrap_key(const unsigned char *wrapped, size_t wrapped_len,
+                              const unsigned char *additional_data = NULL, size_t additional_data_len = 0) const;
+
+        /**
+         * @brief Short value, which identifies the key of this object.
+         *
+         * Key check value is a keyed BLAKE2b hash of a constant string. It is stored in saved wallets, so wrong
+         * password can be detected before anything is decrypted. It doesn't reveal the key.
+         *
+         * @return KEY_CHECK_BYTES bytes long key check value. Empty string if check() is false.
+         */
+        std::string key_check() const;
+
+        /**
+         * @brief Compares key check value with key_check() of this object in constant time.
+         * @param key_check_value Key check value, stored in a wallet.
+         * @return True if key check value belongs to the key of this object, otherwise false.
+         */
+        bool verify_key_check(const std::string& key_check_value) const;
+
+        /// Size of key check value, returned by key_check().
+        static const size_t KEY_CHECK_BYTES = 16;
+
+        /// Size of data key, wrapped with wrap_key().
+        static const size_t WRAPPED_KEY_BYTES = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES + crypto_box_SEEDBYTES +
+                                                crypto_aead_xchacha20poly1305_ietf_ABYTES;  // 72 bytes
+
+        /**
+         * @brief Generates X25519 key pair for receiving shared items (see sharing::share()).
+         *
+         * Secret key has the same size as other keys, so it can be stored in a wallet with wrap_key().
+         *
+         * @param public_key Output buffer of PUBLIC_KEY_BYTES bytes.
+         * @return Secret key. Invalid if memory could not be allocated.
+         */
+        static DerivedKey generate_key_pair(unsigned char *public_key);
+
+        /**
+         * @brief Encrypts data key for the owner of a public key.
+         *
+         * Key is encrypted with libsodium's sealed box, so only the owner of the secret key can decrypt it, but
+         * sender can't be identified.
+         *
+         * @param data_key Key, which will be sealed.
+         * @param public_key Recipient's public key of PUBLIC_KEY_BYTES bytes.
+         * @param sealed Output buffer of SEALED_KEY_BYTES bytes.
+         * @return True if key was sealed, false if data key is invalid or public key is not a valid X25519 key.
+         */
+        static bool seal_key(const DerivedKey& data_key, const unsigned char *public_key, unsigned char *sealed);
+
+        /**
+         * @brief Decrypts data key, that was sealed with seal_key().
+         * @param sealed Sealed key.
+         * @param sealed_len Length of sealed key in bytes. Must be SEALED_KEY_BYTES.
+         * @param public_key Public key of the recipient.
+         * @param secret_key Secret key of the recipient (see generate_key_pair()).
+         * @return Data key. Invalid if key was not sealed for this key pair or if it was changed.
+         */
+        static DerivedKey open_sealed_key(const unsigned char *sealed, size_t sealed_len,
+                                          const unsigned char *public_key, const DerivedKey& secret_key);
+
+        /// Size of public key, returned by generate_key_pair().
+        static const size_t PUBLIC_KEY_BYTES = crypto_box_PUBLICKEYBYTES;  // 32 bytes
+
+        /// Size of data key, sealed with seal_key().
+        static const size_t SEALED_KEY_BYTES = crypto_box_SEALBYTES + crypto_box_SEEDBYTES;  // 80 bytes
+
+        /**
+         * @brief Generates Ed25519 key pair for signing shared items (see sharing::share()).
+         *
+         * Secret key is the 32 bytes seed of the key pair, so it can be stored in a wallet with wrap_key() like
+         * other keys.
+         *
+         * @param public_key Output buffer of SIGNING_PUBLIC_KEY_BYTES bytes.
+         * @return Secret signing key. Invalid if memory could not be allocated.
+         */
+        static DerivedKey generate_signing_key_pair(unsigned char *public_key);
+
+        /**
+         * @brief Signs a message.
+         * @param message Message, which will be signed.
+         * @param message_len Length of message in bytes.
+         * @param signing_key Secret key, returned by generate_signing_key_pair().
+         * @param signature Output buffer of SIGNATURE_BYTES bytes.
+         * @return True if message was signed, false if signing key is invalid or memory could not be allocated.
+         */
+        static bool sign(const unsigned char *message, size_t message_len, const DerivedKey& signing_key,
+                         unsigned char *signature);
+
+        /**
+         * @brief Verifies signature, created with sign().
+         * @param message Signed message.
+         * @param message_len Length of message in bytes.
+         * @param signature Signature of SIGNATURE_BYTES bytes.
+         * @param public_key Signer's public key of SIGNING_PUBLIC_KEY_BYTES bytes.
+         * @return True if message was signed with the secret key of this public key, otherwise false.
+         */
+        static bool verify_signature(const unsigned char *message, size_t message_len, const unsigned char *signature,
+                                     const unsigned char *public_key);
+
+        /// Size of public key, returned by generate_signing_key_pair().
+        static const size_t SIGNING_PUBLIC_KEY_BYTES = crypto_sign_PUBLICKEYBYTES;  // 32 bytes
+
+        /// Size of signature, created with sign().
+        static const size_t SIGNATURE_BYTES = crypto_sign_BYTES;  // 64 bytes
+
         /**
          * @brief Encrypts plain text.
          * We use ChaCha20-Poly1305 authenticated encryption algorithm, implemented in library libsodium.
@@ -79,6 +622,279 @@ namespace electronpass {
          */
         std::string decrypt(const std::string& cipher_text, bool& success) const;
 
+        /**
+         * @brief Encrypts plain text, that is kept in secure memory.
+         *
+         * Same as encrypt(const std::string&, bool&), but plain text doesn't have to be copied to a std::string.
+         *
+         * @param plain_text String, which will be encrypted.
+         * @param cipher_text Encrypted plain text, already converted to Base64. Empty if encryption wasn't successful.
+         * @return True if encryption was successful, false otherwise.
+         */
+        bool encrypt(const SecureString& plain_text, std::string& cipher_text) const;
+
+        /**
+         * @brief Decrypts Base64 encoded cipher text into secure memory.
+         *
+         * Same as decrypt(const std::string&, bool&), but plain text never leaves secure memory. Plain text still
+         * has to be wiped by the caller if it is short (see SecureString).
+         *
+         * @param cipher_text Base64 encoded string, which will be decrypted.
+         * @param plain_text Decrypted text. Empty if decryption wasn't successful.
+         * @return True if message was decoded from cipher text, false otherwise.
+         */
+        bool decrypt(const std::string& cipher_text, SecureString& plain_text) const;
+
+        /**
+         * @brief Encrypts many plain texts at once.
+         *
+         * Every message is encrypted the same way as with encrypt(const std::string&, bool&), but scratch memory
+         * is reused between messages and work can be split between multiple threads. Calling thread does part of
+         * the work, other threads are taken from a pool, which is shared by all Crypto objects. Threads are
+         * started when they are first needed and kept for later calls.
+         *
+         * @param plain_texts Strings, which will be encrypted.
+         * @param success If encryption of all messages was successful. See also check().
+         * @param threads Number of threads to use. If 0, number of hardware threads is used.
+         * @return Encrypted plain texts, already converted to Base64, in the same order as plain_texts. If
+         * encryption wasn't successful returns empty vector.
+         */
+        std::vector<std::string> encrypt_many(const std::vector<std::string>& plain_texts, bool& success,
+                                              unsigned int threads = 1) const;
+
+        /**
+         * @brief Decrypts many Base64 encoded cipher texts at once.
+         *
+         * Every message is decrypted the same way as with decrypt(const std::string&, bool&), but scratch memory
+         * is reused between messages and work can be split between multiple threads (see encrypt_many()).
+         *
+         * @param cipher_texts Base64 encoded strings, which will be decrypted.
+         * @param success For every message true if it was decrypted, false otherwise.
+         * @param threads Number of threads to use. If 0, number of hardware threads is used.
+         * @return Decrypted texts in the same order as cipher_texts, in secure memory. Messages, that couldn't be
+         * decrypted, are empty strings ("").
+         */
+        SecureStringVector decrypt_many(const std::vector<std::string>& cipher_texts, std::vector<bool>& success,
+                                              unsigned int threads = 1) const;
+
+        /**
+         * @brief Encrypts plain text into a caller-provided buffer.
+         *
+         * Output layout is nonce followed by the cipher text and authentication tag. With CHACHA20_POLY1305 cipher
+         * it is the same as with encrypt(const std::string&, bool&) before Base64 encoding. Output buffer must be
+         * exactly cipher_text_size(plain_text_len, cipher) bytes long.
+         *
+         * Encryption can be done in place: plain_text may point to `cipher_text + nonce_size(cipher)`.
+         * Apart from that, buffers must not overlap.
+         *
+         * @param plain_text Data, which will be encrypted.
+         * @param plain_text_len Length of plain_text in bytes.
+         * @param cipher_text Output buffer.
+         * @param cipher_text_len Length of output buffer in bytes.
+         * @param additional_data Data, which is authenticated, but not encrypted (eg. file header). Can be NULL.
+         * @param additional_data_len Length of additional_data in bytes.
+         * @param cipher Encryption algorithm. Must be available on this device (see cipher_available()).
+         * @return True if encryption was successful, false otherwise.
+         */
+        bool encrypt(const unsigned char *plain_text, size_t plain_text_len,
+                     unsigned char *cipher_text, size_t cipher_text_len,
+                     const unsigned char *additional_data = NULL, size_t additional_data_len = 0,
+                     Cipher cipher = Cipher::CHACHA20_POLY1305) const;
+
+        /**
+         * @brief Decrypts raw (not Base64 encoded) cipher text into a caller-provided buffer.
+         *
+         * Output buffer must be exactly plain_text_size(cipher_text_len, cipher) bytes long.
+         *
+         * Decryption can be done in place: plain_text may point to `cipher_text + nonce_size(cipher)`.
+         * Apart from that, buffers must not overlap. If decryption fails, content of plain_text is undefined.
+         *
+         * @param cipher_text Nonce, followed by encrypted data and authentication tag.
+         * @param cipher_text_len Length of cipher_text in bytes.
+         * @param plain_text Output buffer.
+         * @param plain_text_len Length of output buffer in bytes.
+         * @param additional_data Additional data, that was used for encryption. Can be NULL.
+         * @param additional_data_len Length of additional_data in bytes.
+         * @param cipher Encryption algorithm, that was used for encryption.
+         * @return True if data was decrypted and authenticated, false otherwise.
+         */
+        bool decrypt(const unsigned char *cipher_text, size_t cipher_text_len,
+                     unsigned char *plain_text, size_t plain_text_len,
+                     const unsigned char *additional_data = NULL, size_t additional_data_len = 0,
+                     Cipher cipher = Cipher::CHACHA20_POLY1305) const;
+
+        /// Number of nonce bytes stored at the beginning of the raw cipher text (for CHACHA20_POLY1305 cipher).
+        static const size_t NONCE_BYTES = crypto_aead_chacha20poly1305_NPUBBYTES;  // 8 bytes
+
+        /// Number of bytes, which encryption adds to the plain text (for CHACHA20_POLY1305 cipher).
+        static const size_t OVERHEAD_BYTES = NONCE_BYTES + crypto_aead_chacha20poly1305_ABYTES;  // 24 bytes
+
+        /**
+         * @brief Number of nonce bytes stored at the beginning of the raw cipher text.
+         * @param cipher Encryption algorithm.
+         * @return Nonce size in bytes.
+         */
+        static size_t nonce_size(Cipher cipher);
+
+        /**
+         * @brief Size of raw cipher text for plain text of given length.
+         * @param plain_text_len Length of plain text in bytes.
+         * @param cipher Encryption algorithm.
+         * @return Size of output buffer needed by encrypt(const unsigned char*, size_t, unsigned char*, size_t,
+         * const unsigned char*, size_t, Cipher).
+         */
+        static size_t cipher_text_size(size_t plain_text_len, Cipher cipher = Cipher::CHACHA20_POLY1305);
+
+        /**
+         * @brief Size of plain text for raw cipher text of given length.
+         * @param cipher_text_len Length of raw cipher text in bytes.
+         * @param cipher Encryption algorithm.
+         * @return Size of output buffer needed by decrypt(const unsigned char*, size_t, unsigned char*, size_t,
+         * const unsigned char*, size_t, Cipher). If cipher text is too short to be valid, returns 0.
+         */
+        static size_t plain_text_size(size_t cipher_text_len, Cipher cipher = Cipher::CHACHA20_POLY1305);
+
+        /**
+         * @brief Checks if encryption algorithm can be used on this device.
+         *
+         * AES256_GCM needs hardware AES support (AES-NI on x86). Other algorithms are always available.
+         *
+         * @param cipher Encryption algorithm.
+         * @return True if cipher is available, otherwise false.
+         */
+        static bool cipher_available(Cipher cipher);
+
+        /**
+         * @brief Fastest encryption algorithm, available on this device.
+         *
+         * Use it for data that stays on this device. Wallets are saved with XCHACHA20_POLY1305 by default, because
+         * data encrypted with AES256_GCM can't be decrypted on devices without hardware AES.
+         *
+         * @return AES256_GCM if it is available, otherwise XCHACHA20_POLY1305.
+         */
+        static Cipher preferred_cipher();
+
+        /**
+         * @brief Encryption algorithm, used by serialization::save().
+         *
+         * Algorithm is stored in saved wallet. By default it is XCHACHA20_POLY1305, which every device can decrypt.
+         *
+         * @return Encryption algorithm for saving wallets.
+         */
+        Cipher cipher() const;
+
+        /**
+         * @brief Sets encryption algorithm, used by serialization::save().
+         *
+         * Wallets encrypted with AES256_GCM can only be opened on devices, where it is available, so only set it if
+         * wallet never leaves devices with hardware AES support.
+         *
+         * @param cipher Encryption algorithm.
+         * @return True if cipher was set, false if it is not available on this device.
+         */
+        bool set_cipher(Cipher cipher);
+
+        /**
+         * @brief Encrypts large plain text in segments, which are processed in parallel.
+         *
+         * Plain text is split into segments of SEGMENT_BYTES (the last one can be shorter, and empty plain text
+         * is one empty segment). Output starts with a random nonce, followed by segments, each encrypted with its
+         * own nonce (random nonce with segment index mixed in) and followed by its authentication tag. Index of
+         * the segment, number of all segments and whether segment is the last one are authenticated together
+         * with additional data, so reordering, removing or truncating segments is detected.
+         *
+         * Segments are split between the calling thread and the shared worker pool (see encrypt_many()).
+         *
+         * Output buffer must be exactly segmented_cipher_text_size(plain_text_len, cipher) bytes long.
+         *
+         * @param plain_text Data, which will be encrypted.
+         * @param plain_text_len Length of plain text in bytes.
+         * @param cipher_text Output buffer.
+         * @param cipher_text_len Length of output buffer in bytes.
+         * @param additional_data Data, which is authenticated with every segment, but not encrypted. Can be NULL.
+         * @param additional_data_len Length of additional data in bytes.
+         * @param cipher Encryption algorithm. Must be available on this device (see cipher_available()).
+         * @param threads Number of threads to use. If 0, number of hardware threads is used.
+         * @return True if encryption was successful, false otherwise.
+         */
+        bool encrypt_segmented(const unsigned char *plain_text, size_t plain_text_len,
+                               unsigned char *cipher_text, size_t cipher_text_len,
+                               const unsigned char *additional_data, size_t additional_data_len,
+                               Cipher cipher, unsigned int threads = 0) const;
+
+        /**
+         * @brief Decrypts data encrypted with encrypt_segmented().
+         *
+         * Segments are decrypted in parallel like in encrypt_segmented(). Output buffer must be exactly
+         * segmented_plain_text_size(cipher_text_len, cipher) bytes long. If decryption fails, output buffer is wiped.
+         *
+         * @param cipher_text Data, that was encrypted with encrypt_segmented().
+         * @param cipher_text_len Length of cipher_text in bytes.
+         * @param plain_text Output buffer.
+         * @param plain_text_len Length of output buffer in bytes.
+         * @param additional_data Additional data, that was used for encryption. Can be NULL.
+         * @param additional_data_len Length of additional data in bytes.
+         * @param cipher Encryption algorithm, that was used for encryption.
+         * @param threads Number of threads to use. If 0, number of hardware threads is used.
+         * @return True if all segments were decrypted and authenticated, false otherwise.
+         */
+        bool decrypt_segmented(const unsigned char *cipher_text, size_t cipher_text_len,
+                               unsigned char *plain_text, size_t plain_text_len,
+                               const unsigned char *additional_data, size_t additional_data_len,
+                               Cipher cipher, unsigned int threads = 0) const;
+
+        /**
+         * @brief Size of encrypt_segmented() output for plain text of given length.
+         * @param plain_text_len Length of plain text in bytes.
+         * @param cipher Encryption algorithm.
+         * @return Size of segmented cipher text in bytes.
+         */
+        static size_t segmented_cipher_text_size(size_t plain_text_len, Cipher cipher);
+
+        /**
+         * @brief Size of plain text for segmented cipher text of given length.
+         * @param cipher_text_len Length of segmented cipher text in bytes.
+         * @param cipher Encryption algorithm.
+         * @return Size of plain text in bytes. If cipher text length is not valid, returns 0.
+         */
+        static size_t segmented_plain_text_size(size_t cipher_text_len, Cipher cipher);
+
+        /// Size of plain text segments used by encrypt_segmented() and decrypt_segmented().
+        static const size_t SEGMENT_BYTES = 1024 * 1024;
+
+        /**
+         * @brief Encrypts data read from input stream and writes it to output stream.
+         *
+         * We use XChaCha20-Poly1305 secret stream construction, implemented in library libsodium. Input is read
+         * and encrypted in chunks of STREAM_CHUNK_BYTES, so memory usage does not depend on the size of the data.
+         * Each chunk is authenticated separately and the last one is marked as final, so reordering and truncation
+         * of the encrypted data are detected.
+         *
+         * Output is raw binary data (not Base64 encoded): stream header followed by encrypted chunks.
+         *
+         * @param in Stream with data, which will be encrypted. It is read until end of file.
+         * @param out Stream, to which encrypted data will be written.
+         * @param additional_data Data, which is authenticated together with the stream, but not encrypted.
+         * @return True if encryption was successful, false otherwise.
+         */
+        bool encrypt_stream(std::istream& in, std::ostream& out, const std::string& additional_data = "") const;
+
+        /**
+         * @brief Decrypts data encrypted with encrypt_stream().
+         *
+         * Chunks are decrypted as they are read, so decrypted data is written to the output stream before the
+         * whole input is authenticated. Output should be discarded if this function returns false.
+         *
+         * @param in Stream with encrypted data. It is read until final chunk is reached.
+         * @param out Stream, to which decrypted data will be written.
+         * @param additional_data Additional data, that was used for encryption.
+         * @return True if all data was decrypted and authenticated, false otherwise.
+         */
+        bool decrypt_stream(std::istream& in, std::ostream& out, const std::string& additional_data = "") const;
+
+        /// Size of plain text chunks used by encrypt_stream() and decrypt_stream().
+        static const size_t STREAM_CHUNK_BYTES = 64 * 1024;
+
         /**
          * @brief Checks if Crypto initialization was successful.
          * Initialization consist of:
@@ -90,6 +906,9 @@ namespace electronpass {
 
         /**
          * @brief Function for encoding to Base64.
+         *
+         * Uses SSSE3 or AVX2 when CPU supports them.
+         *
          * @param s String, which will be encoded in Base64.
          * @return Encoded string.
          */
@@ -98,8 +917,9 @@ namespace electronpass {
         /**
          * @brief Function for decoding from Base64.
          *
-         * If string has invalid length (not a multiple of 4), then empty string ("")
-         * is returned.
+         * If string has invalid length (not a multiple of 4), contains characters outside of Base64 alphabet,
+         * padding anywhere else than at the end or non-zero bits after the last byte, then empty string ("")
+         * is returned. Uses SSSE3 or AVX2 when CPU supports them.
          *
          * @param s String, which will be decoded from Base64.
          * @return Decoded string.
@@ -112,6 +932,139 @@ namespace electronpass {
          */
         static std::string generate_uuid();
     };
+
+    /**
+     * @brief Decrypts data of Crypto::encrypt(const std::string&, bool&) piece by piece.
+     *
+     * Cipher text (nonce followed by encrypted data and tag, already decoded from Base64) can be passed in chunks of
+     * any size, and plain text is returned as soon as it is decrypted, so the whole message never has to be held in
+     * memory. Authentication tag is only checked by finish(), so **plain text must not be trusted until finish()
+     * succeeds**.
+     *
+     * Output is identical to Crypto::decrypt(const std::string&, bool&) (original ChaCha20-Poly1305 without
+     * additional data).
+     */
+    class IncrementalDecryptor {
+        static const size_t BLOCK_BYTES = 64;
+        static const size_t TAG_BYTES = crypto_aead_chacha20poly1305_ABYTES;  // 16 bytes
+
+        unsigned char key[crypto_aead_chacha20poly1305_KEYBYTES];
+        unsigned char nonce[crypto_aead_chacha20poly1305_NPUBBYTES];
+        size_t nonce_len = 0;
+        crypto_onetimeauth_poly1305_state mac;
+        // Cipher text, which can't be decrypted yet. Last TAG_BYTES of the input might be the tag.
+        unsigned char pending[BLOCK_BYTES + TAG_BYTES];
+        size_t pending_len = 0;
+        // Number of bytes decrypted so far.
+        uint64_t decrypted_len = 0;
+        bool failed;
+
+        void decrypt(const unsigned char *cipher_text, size_t len, SecureBuffer& plain_text);
+
+      public:
+        /**
+         * @brief Starts decryption with crypto's key.
+         * @param crypto Crypto, with which data was encrypted. Key is copied.
+         */
+        IncrementalDecryptor(const Crypto& crypto);
+
+        IncrementalDecryptor(const IncrementalDecryptor&) = delete;
+        IncrementalDecryptor& operator=(const IncrementalDecryptor&) = delete;
+
+        /// Destructor, which wipes key and state.
+        ~IncrementalDecryptor();
+
+        /**
+         * @brief Decrypts next chunk of cipher text.
+         * @param cipher_text Next chunk of cipher text.
+         * @param len Length of the chunk.
+         * @param plain_text Decrypted bytes are appended to it. Up to the last 79 bytes of input are held back until
+         * more data arrives.
+         * @return False if crypto was not valid.
+         */
+        bool update(const unsigned char *cipher_text, size_t len, SecureBuffer& plain_text);
+
+        /**
+         * @brief Decrypts the rest of the cipher text and verifies authentication tag.
+         *
+         * Decryptor can't be used anymore after it.
+         *
+         * @param plain_text Remaining decrypted bytes are appended to it.
+         * @return True if all data was authentic, otherwise false.
+         */
+        bool finish(SecureBuffer& plain_text);
+    };
+
+    /**
+     * @brief Encodes data to Base64 in chunks.
+     *
+     * Bytes, that don't make a whole group of 3, are kept until the next call, so chunks can have any size and output
+     * is the same as Crypto::base64_encode() of all chunks together.
+     */
+    class Base64Encoder {
+        unsigned char pending[3];
+        size_t pending_len = 0;
+
+      public:
+        /**
+         * @brief Encodes next chunk.
+         * @param input Next chunk of data.
+         * @param len Length of the chunk.
+         * @param output Output buffer of at least max_output_size(len) bytes.
+         * @return Number of characters written to output.
+         */
+        size_t update(const unsigned char *input, size_t len, char *output);
+
+        /**
+         * @brief Encodes remaining bytes with padding. Encoder can be used for new data after it.
+         * @param output Output buffer of at least FINISH_BYTES bytes.
+         * @return Number of characters written to output.
+         */
+        size_t finish(char *output);
+
+        /// Maximum number of characters, that update() writes for input of given length.
+        static size_t max_output_size(size_t len);
+
+        /// Maximum number of characters, that finish() writes.
+        static const size_t FINISH_BYTES = 4;
+    };
+
+    /**
+     * @brief Decodes Base64 in chunks.
+     *
+     * Characters, that don't make a whole group of 4, are kept until the next call, so chunks can have any size.
+     * Validation is as strict as in Crypto::base64_decode(): invalid characters, padding anywhere else than at the
+     * end or non-zero bits after the last byte make decoding fail.
+     */
+    class Base64Decoder {
+        char pending[4];
+        size_t pending_len = 0;
+        // Padding was decoded, so no more data is allowed.
+        bool padded = false;
+        bool failed = false;
+
+        bool decode(const char *input, size_t len, unsigned char *output, size_t& output_len);
+
+      public:
+        /**
+         * @brief Decodes next chunk.
+         * @param input Next chunk of Base64.
+         * @param len Length of the chunk.
+         * @param output Output buffer of at least max_output_size(len) bytes.
+         * @param output_len Number of bytes written to output.
+         * @return False if data is not valid Base64. Decoder can't be used after that.
+         */
+        bool update(const char *input, size_t len, unsigned char *output, size_t& output_len);
+
+        /**
+         * @brief Checks that Base64 ended with a whole group of 4 characters. Decoder can be used for new data after it.
+         * @return True if all data was valid Base64, otherwise false.
+         */
+        bool finish();
+
+        /// Maximum number of bytes, that update() writes for input of given length.
+        static size_t max_output_size(size_t len);
+    };
 }
 
 
@@ -63,7 +63,7 @@ namespace electronpass {
          * @param uppercase Number of uppercase letters to be included.
          * @details Characters are randomly selected to fulfill len, digits and symbols respectively.
          * @details Lowercase letters are added at the end to match len parameter.
-         * @details Characters are selected and shuffled using mt19937 algorithm and C++ device_random seed.
+         * @details Characters are selected and shuffled using cryptographically secure generator (see Random).
          * @return String of desired length.
          */
         std::string generate_random_pass(int len, int digits, int symbols, int uppercase);
@@ -71,7 +71,7 @@ namespace electronpass {
         /**
          * @brief Generates random password.
          * @param len Desired length of password.
-         * @details Characters are selected using mt19937 algorithm and C++ device_random seed.
+         * @details Characters are selected using cryptographically secure generator (see Random).
          * @return String of desired length.
          */
         std::string generate_random_pass(int len);
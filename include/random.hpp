@@ -0,0 +1,73 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELECTRONPASS_RANDOM_HPP
+#define ELECTRONPASS_RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @file random.hpp
+ * @brief Defined fast cryptographically secure random number generator.
+ */
+
+namespace electronpass {
+    /**
+     * @brief Buffered cryptographically secure random number generator.
+     *
+     * Each thread has its own generator, seeded from libsodium's system random (randombytes_buf()) on first use.
+     * Random bytes are ChaCha20 key stream, generated BUFFER_BYTES at a time. First 32 bytes of each buffer replace
+     * the key (fast key erasure) and bytes are wiped as soon as they are used, so earlier output can't be recovered
+     * from memory. This way most values cost only a copy from the buffer instead of a system call.
+     *
+     * Random is used for nonces, ids (Crypto::generate_uuid()) and generated passwords. Long term keys are still
+     * taken directly from system random. On POSIX systems generators are reseeded in the child after fork(), so
+     * parent and child don't share random values.
+     */
+    class Random {
+      public:
+        /**
+         * @brief Fills buffer with random bytes.
+         * @param buffer Output buffer.
+         * @param len Number of bytes.
+         */
+        static void bytes(void *buffer, size_t len);
+
+        /// Random 32-bit integer.
+        static uint32_t uint32();
+
+        /// Random 64-bit integer.
+        static uint64_t uint64();
+
+        /**
+         * @brief Uniformly distributed random integer, which is smaller than upper bound.
+         *
+         * Uses multiplication instead of modulo and rejects the few values, that would make some results more
+         * likely than others, so result is unbiased.
+         *
+         * @param upper_bound Upper bound (exclusive).
+         * @return Random integer between 0 and upper_bound - 1. 0 if upper bound is smaller than 2.
+         */
+        static uint32_t uniform(uint32_t upper_bound);
+
+        /// Size of key stream, that is generated at once.
+        static const size_t BUFFER_BYTES = 1024;
+    };
+}
+
+#endif // ELECTRONPASS_RANDOM_HPP
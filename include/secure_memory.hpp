@@ -0,0 +1,181 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELECTRONPASS_SECURE_MEMORY_HPP
+#define ELECTRONPASS_SECURE_MEMORY_HPP
+
+#include <sodium.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <new>
+
+/**
+ * @file secure_memory.hpp
+ * @brief Defined pooled secure memory for plain text buffers.
+ */
+
+namespace electronpass {
+    /**
+     * @brief Pool of locked memory, which is wiped when it is freed.
+     *
+     * Allocating every buffer with sodium_malloc costs a few system calls and guard pages. SecureArena instead
+     * allocates large regions with sodium_malloc once (they are locked, so they are never swapped to disk) and
+     * splits them into blocks of power of two sizes. Freed blocks are wiped and kept on a free list of their size,
+     * so they can be reused without system calls. Blocks larger than MAX_BLOCK_BYTES get their own sodium_malloc
+     * allocation.
+     *
+     * Regions are never returned to the system, so arena only grows to the largest amount of plain text, that was
+     * in memory at the same time. All functions are thread-safe.
+     */
+    class SecureArena {
+        // Free lists, one for each block size.
+        static const size_t SIZE_CLASSES = 15;
+        void *free_lists[SIZE_CLASSES];
+
+        // Remaining unused memory of the last region.
+        unsigned char *region_begin;
+        unsigned char *region_end;
+
+        size_t region_count;
+        size_t used_bytes;
+        std::mutex mutex;
+
+        SecureArena();
+
+      public:
+        SecureArena(const SecureArena&) = delete;
+        SecureArena& operator=(const SecureArena&) = delete;
+
+        /**
+         * @brief Arena, shared by all SecureAllocator objects.
+         *
+         * Arena is never destroyed, so memory can still be freed during destruction of static objects.
+         *
+         * @return Global arena.
+         */
+        static SecureArena& instance();
+
+        /**
+         * @brief Allocates memory from the arena.
+         * @param size Number of bytes.
+         * @return Memory, aligned for any type. NULL if memory couldn't be allocated.
+         */
+        void *allocate(size_t size);
+
+        /**
+         * @brief Wipes memory and returns it to the arena.
+         * @param p Memory, allocated with allocate().
+         * @param size Number of bytes, that were allocated.
+         */
+        void deallocate(void *p, size_t size);
+
+        /**
+         * @brief Number of bytes, that are currently allocated.
+         * @return Sum of block sizes of all allocations, that weren't freed yet.
+         */
+        size_t allocated_bytes();
+
+        /**
+         * @brief Number of regions, that were allocated from the system.
+         * @return Number of regions.
+         */
+        size_t regions();
+
+        /// Size of regions, allocated with sodium_malloc.
+        static const size_t REGION_BYTES = 1024 * 1024;
+
+        /// Smallest block size.
+        static const size_t MIN_BLOCK_BYTES = 16;
+
+        /// Largest block size, that is allocated from regions.
+        static const size_t MAX_BLOCK_BYTES = MIN_BLOCK_BYTES << (SIZE_CLASSES - 1);  // 256 KiB
+    };
+
+    /**
+     * @brief Standard library allocator, which allocates memory from SecureArena.
+     *
+     * Use it for containers, that hold plain text, eg. SecureString.
+     */
+    template <typename T>
+    class SecureAllocator {
+      public:
+        typedef T value_type;
+
+        SecureAllocator() {}
+
+        template <typename U>
+        SecureAllocator(const SecureAllocator<U>&) {}
+
+        /// Allocates memory for n objects.
+        T *allocate(size_t n) {
+            if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_alloc();
+            void *p = SecureArena::instance().allocate(n * sizeof(T));
+            if (p == NULL) throw std::bad_alloc();
+            return static_cast<T *>(p);
+        }
+
+        /// Wipes and frees memory for n objects.
+        void deallocate(T *p, size_t n) {
+            SecureArena::instance().deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const SecureAllocator<U>&) const {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const SecureAllocator<U>&) const {
+            return false;
+        }
+    };
+
+    /**
+     * @brief String, which stores its characters in SecureArena.
+     *
+     * **Note:** short strings (up to 15 characters with libstdc++) are stored inside the string object itself
+     * (small string optimization) and never reach SecureArena, so they are not wiped automatically. Objects holding
+     * such strings must call wipe() before they are destroyed or moved from.
+     */
+    typedef std::basic_string<char, std::char_traits<char>, SecureAllocator<char>> SecureString;
+
+    /**
+     * @brief Wipes all characters of the string, including unused capacity, and clears it.
+     *
+     * Wipes the string's storage wherever it is, also when it is stored inside the string object. Works for
+     * SecureString and for plain text, that had to be kept in std::string.
+     *
+     * @param string String to wipe.
+     */
+    template <typename Allocator>
+    void wipe(std::basic_string<char, std::char_traits<char>, Allocator>& string) {
+        // Resizing within capacity doesn't reallocate, so all of the storage is wiped.
+        string.resize(string.capacity());
+        if (!string.empty()) sodium_memzero(&string[0], string.size());
+        string.clear();
+    }
+
+    /// Vector of bytes, stored in SecureArena.
+    typedef std::vector<unsigned char, SecureAllocator<unsigned char>> SecureBuffer;
+
+    /// Vector of strings. String objects themselves are stored in SecureArena, so short strings are wiped as well.
+    typedef std::vector<SecureString, SecureAllocator<SecureString>> SecureStringVector;
+}
+
+#endif // ELECTRONPASS_SECURE_MEMORY_HPP
@@ -20,6 +20,8 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <string>
 #include <vector>
+#include <istream>
+#include <ostream>
 #include <exception>
 
 #include "json/json.h"
@@ -38,9 +40,36 @@ namespace electronpass {
      * @brief Functions for serialization and deserialization of JSON data.
      */
     namespace serialization {
+        /**
+         * @brief Compression of wallet payload before it is encrypted.
+         *
+         * - NONE: payload is encrypted as it is
+         * - LZ: built-in fast LZ77 codec (LZ4 block format), always available
+         * - ZLIB: zlib (deflate), only available if zlib was found when libelectronpass was built
+         *
+         * Compression is recorded in the wallet header, so wallets are loaded the same way regardless of it.
+         *
+         * **Note:** size of a compressed wallet depends on how compressible its contents are. Anyone, who can see
+         * the file and influence part of the contents (eg. shared items or site names), can learn about the rest of
+         * it from the size. Compression is therefore off by default; only enable it when this doesn't matter.
+         */
+        enum class Compression : uint8_t {
+            NONE, LZ, ZLIB
+        };
+
+        /**
+         * @brief Checks if compression can be used on this build.
+         * @param compression Compression to check.
+         * @return True if wallets can be saved and loaded with it.
+         */
+        bool compression_available(Compression compression);
+
         /**
          * @brief Deserialize JSON data and create Wallet object from it.
          *
+         * JSON is parsed in a single pass and items are built directly, without a JSON tree. Unknown keys are ignored.
+         * If JSON is invalid, empty wallet is returned.
+         *
          * @param json JSON to deserialize.
          * @return Wallet object generated from JSON data.
          */
@@ -57,13 +86,17 @@ namespace electronpass {
         /**
          * @brief Loads wallet object from disk data.
          *
+         * Binary wallets are recognized by their magic bytes. Other data is loaded as legacy JSON wallet.
+         *
          * Error codes:
          *
          * - 0: success
-         * - 1: could not decrypt data
-         * - 2: invalid json
+         * - 1: could not decrypt data (wallet was changed or corrupted, or wrong password of a legacy JSON wallet)
+         * - 2: invalid json or payload, unsupported wallet version or cipher (eg. AES-256-GCM without hardware support)
+         * - 3: crypto uses different key derivation parameters than the wallet (see kdf_params())
+         * - 4: wrong password (legacy JSON wallets without key check value report 1 instead)
          *
-         * **Note:** for now version is ignored. Will change in the future.
+         * **Note:** for now version of legacy JSON wallets is ignored.
          *
          * @param data Data stored on disk
          * @param crypto Crypto object used for encryption
@@ -73,19 +106,162 @@ namespace electronpass {
         electronpass::Wallet load(const std::string &data, const Crypto &crypto, int &error);
 
         /**
-         * @brief Converts wallet to json that can be saved on disk.
+         * @brief Converts wallet to binary data that can be saved on disk.
+         *
+         * Data consists of a header (magic bytes, version, timestamp, key derivation parameters and wrapped data
+         * key) followed by raw nonce and cipher text. Items are encoded in a compact binary payload instead of JSON
+         * (see Data Definitions.md). Wallet is encrypted with a new random data key, which is
+         * wrapped with crypto's key (see Crypto::generate_data_key()). Header is authenticated.
+         *
+         * Key derivation parameters are taken from crypto, so create it with parameters of the wallet that
+         * was loaded, or with KdfParams::generate() for a new wallet. Wallet is encrypted with Crypto::cipher().
+         * Wallets larger than Crypto::SEGMENT_BYTES are encrypted in segments on all available cores (see
+         * Crypto::encrypt_segmented()).
+         *
+         * If compression is set, payload is compressed before it is encrypted, unless compression doesn't make it
+         * smaller.
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 1: could not encrypt wallet
+         * - 2: compression is not available (see compression_available())
+         *
+         * @param wallet Wallet to save
+         * @param crypto Crypto object used for encryption
+         * @param error Error that has occurred
+         * @param compression Compression of the payload
+         * @return Data that can be saved to disk
+         */
+        std::string save(const Wallet &wallet, const Crypto &crypto, int &error,
+                         Compression compression = Compression::NONE);
+
+        /**
+         * @brief Changes password of a saved wallet.
+         *
+         * Only the wrapped data key in the header is replaced, so the wallet doesn't have to be decrypted and
+         * encrypted again. Wallets saved before data keys were introduced are loaded and saved again instead.
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 1: could not decrypt data key or wallet
+         * - 2: invalid header, unsupported wallet version or invalid parameters
+         * - 3: old_crypto uses different key derivation parameters than the wallet (see kdf_params())
+         * - 4: wrong old password (legacy JSON wallets without key check value report 1 instead)
+         *
+         * @param data Data stored on disk
+         * @param old_crypto Crypto object with current password of the wallet
+         * @param new_crypto Crypto object with new password (and its key derivation parameters)
+         * @param error Error that has occurred
+         * @return Data with new password, that can be saved to disk. Empty string on error.
+         */
+        std::string change_password(const std::string &data, const Crypto &old_crypto, const Crypto &new_crypto,
+                                    int &error);
+
+        /**
+         * @brief Reads key derivation parameters of a saved wallet.
+         *
+         * Use returned parameters for creating Crypto (or DerivedKey), which will be used for loading the wallet.
+         * Only the header of the wallet is read, so data doesn't have to contain the whole wallet.
+         *
+         * Legacy wallets don't store their parameters, so KdfParams::legacy() is returned for them.
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 2: invalid header, unsupported wallet version or invalid parameters
+         *
+         * @param data Data stored on disk (or at least its beginning, that contains the whole header)
+         * @param error Error that has occurred
+         * @return Key derivation parameters
+         */
+        KdfParams kdf_params(const std::string &data, int &error);
+
+        /**
+         * @brief Loads wallet object from a stream.
+         *
+         * Wallets saved with save(const Wallet&, const Crypto&, std::ostream&, int&) are decrypted chunk by chunk,
+         * while they are being read. Legacy JSON wallets are also decoded, decrypted and parsed while they are being
+         * read (see IncrementalDecryptor), and the wallet is only returned after its authentication tag is verified.
+         * Other wallets are read whole.
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 1: could not decrypt data (wallet was changed or corrupted, or wrong password of a legacy JSON wallet)
+         * - 2: invalid json (also of decrypted legacy wallet) or payload, unsupported wallet version or cipher
+         * (eg. AES-256-GCM without hardware support)
+         * - 3: crypto uses different key derivation parameters than the wallet (see kdf_params())
+         * - 4: wrong password (legacy JSON wallets without key check value report 1 instead)
+         *
+         * @param in Stream with data stored on disk
+         * @param crypto Crypto object used for encryption
+         * @param error Error that has occurred
+         * @return Wallet object
+         */
+        electronpass::Wallet load(std::istream &in, const Crypto &crypto, int &error);
+
+        /**
+         * @brief Encrypts wallet and writes it to a stream.
+         *
+         * Wallet is encrypted with Crypto::encrypt_stream(), so encrypted data is written to the stream chunk by chunk
+         * and is never held in memory as a whole.
+         *
+         * Payload is compressed the same way as by save(const Wallet&, const Crypto&, int&, Compression).
          *
          * Error codes:
          *
          * - 0: success
          * - 1: could not encrypt wallet
+         * - 2: compression is not available (see compression_available())
+         *
+         * @param wallet Wallet to save
+         * @param crypto Crypto object used for encryption
+         * @param out Stream to which encrypted wallet is written
+         * @param error Error that has occurred
+         * @param compression Compression of the payload
+         */
+        void save(const Wallet &wallet, const Crypto &crypto, std::ostream &out, int &error,
+                  Compression compression = Compression::NONE);
+
+        /**
+         * @brief Reads wallet from a file and decrypts it.
+         *
+         * Whole file is read into memory once, with a single allocation, and wallet is decrypted from that copy. File
+         * is not mapped into memory, so changes to the file while it is loaded can't affect decryption.
+         *
+         * Error codes are the same as for load(const std::string&, const Crypto&, int&), with one addition:
+         *
+         * - 5: could not open or read the file
+         *
+         * @param path Path to the wallet file
+         * @param crypto Crypto object used for encryption
+         * @param error Error that has occurred
+         * @return Wallet object
+         */
+        electronpass::Wallet load_file(const std::string &path, const Crypto &crypto, int &error);
+
+        /**
+         * @brief Encrypts wallet and saves it to a file.
+         *
+         * Wallet is saved with save(const Wallet&, const Crypto&, int&, Compression) and written with one write
+         * into a temporary file next to path, which is flushed to disk and then renamed over path. File at path
+         * therefore always holds either the old or the new wallet, even if the process or the system crashes
+         * while saving. New file is only readable and writable by its owner.
+         *
+         * Error codes are the same as for save(const Wallet&, const Crypto&, int&, Compression), with one addition:
+         *
+         * - 5: could not write the file (path was not changed)
          *
          * @param wallet Wallet to save
          * @param crypto Crypto object used for encryption
+         * @param path Path to the wallet file
          * @param error Error that has occurred
-         * @return JSON that can be saved to disk
+         * @param compression Compression of the payload
          */
-        std::string save(const Wallet &wallet, const Crypto &crypto, int &error);
+        void save_file(const Wallet &wallet, const Crypto &crypto, const std::string &path, int &error,
+                       Compression compression = Compression::NONE);
 
         /**
          * @brief Export data to csv string.
@@ -0,0 +1,91 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELECTRONPASS_SHARING_HPP
+#define ELECTRONPASS_SHARING_HPP
+
+#include <string>
+#include <vector>
+
+#include "wallet.hpp"
+#include "crypto.hpp"
+
+/**
+ * @file sharing.hpp
+ * @brief Defined functions for sharing wallet items with other users.
+ */
+
+namespace electronpass {
+    /**
+     * @brief Functions for sharing wallet items with other users.
+     *
+     * Every user has an X25519 key pair (see Crypto::generate_key_pair()). Items are encrypted once with a random
+     * content key, and only the content key is encrypted for each recipient's public key, so sharing with many
+     * recipients costs one encryption of the items and a small sealed key per recipient.
+     *
+     * Sealed keys don't identify the sender, so every user also has an Ed25519 key pair (see
+     * Crypto::generate_signing_key_pair()). Shared data is signed with the sender's key, and recipients only accept
+     * it if it was signed by the sender they expect.
+     */
+    namespace sharing {
+        /**
+         * @brief Encrypts items for a group of recipients.
+         *
+         * Items are serialized like a wallet and encrypted with XChaCha20-Poly1305, which is available on every
+         * platform. Data starts with magic bytes and a list of sealed content keys, one per recipient (see
+         * Crypto::seal_key()). The list is authenticated together with the items. Data ends with the sender's
+         * signature of everything before it (see Crypto::sign()).
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 1: could not encrypt items, seal content key (eg. invalid public key) or sign data
+         * - 2: no recipients or public key of wrong size
+         *
+         * @param items Items to share. Items with the same id are only shared once.
+         * @param public_keys Public keys of recipients, each Crypto::PUBLIC_KEY_BYTES bytes.
+         * @param signing_key Sender's secret signing key (see Crypto::generate_signing_key_pair()).
+         * @param error Error that has occurred
+         * @return Data, that can be sent to recipients. Empty string on error.
+         */
+        std::string share(const std::vector<Wallet::Item> &items, const std::vector<std::string> &public_keys,
+                          const DerivedKey &signing_key, int &error);
+
+        /**
+         * @brief Decrypts items, that were shared with share().
+         *
+         * Error codes:
+         *
+         * - 0: success
+         * - 1: could not decrypt items (data was changed or corrupted)
+         * - 2: invalid data or unsupported version
+         * - 3: data was not signed by the sender (or was changed after it was signed)
+         * - 4: items were not shared with this key pair
+         *
+         * @param data Data, returned by share().
+         * @param public_key Recipient's public key.
+         * @param secret_key Recipient's secret key.
+         * @param sender_public_key Sender's signing public key, Crypto::SIGNING_PUBLIC_KEY_BYTES bytes.
+         * @param error Error that has occurred
+         * @return Wallet with shared items.
+         */
+        electronpass::Wallet receive(const std::string &data, const std::string &public_key,
+                                     const DerivedKey &secret_key, const std::string &sender_public_key, int &error);
+    }
+}
+
+#endif //ELECTRONPASS_SHARING_HPP
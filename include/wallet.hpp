@@ -19,12 +19,14 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
 #define ELECTRONPASS_WALLET_HPP
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <chrono>
 #include <set>
 
 #include "crypto.hpp"
+#include "secure_memory.hpp"
 
 /**
  * @file wallet.hpp
@@ -37,6 +39,131 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  *
  * This is the main namespace that libelectronpass uses for its classes and functions.
  */
+namespace electronpass {
+    /**
+     * @brief Compact id of a wallet item.
+     *
+     * Ids are stored in JSON as strings. Ids, generated by libelectronpass, are 24 random bytes encoded in Base64.
+     * ItemId keeps such ids (and all other ids that are canonical Base64 of at most MAX_BYTES bytes) as raw bytes
+     * inline, so they don't allocate and are compared and hashed as a few machine words. Other ids (eg. "id1") are kept
+     * as text: inline if they are not longer than MAX_BYTES, otherwise on the heap.
+     *
+     * Conversion from and to string is exact: ItemId(s).to_string() == s for every string s.
+     */
+    class ItemId {
+      public:
+        /// Maximum number of bytes, that are stored inline.
+        static const size_t MAX_BYTES = 24;
+
+      private:
+        enum class Kind : uint8_t {
+            BINARY, TEXT
+        };
+
+        union {
+            unsigned char bytes[MAX_BYTES];
+            // Text, that doesn't fit inline.
+            char *heap;
+        };
+        uint32_t length;
+        Kind kind;
+
+        void assign(const char *id, size_t len);
+        void release();
+
+      public:
+        /// Creates an empty id.
+        ItemId();
+
+        /**
+         * @brief Creates id from its string representation.
+         * @param id Id as stored in JSON.
+         */
+        ItemId(const std::string& id);
+
+        /**
+         * @brief Creates id from its string representation.
+         * @param id Id as stored in JSON. Must be null terminated.
+         */
+        ItemId(const char *id);
+
+        /**
+         * @brief Creates id from its string representation, which doesn't have to be null terminated.
+         * @param id Id as stored in JSON.
+         * @param len Length of id.
+         */
+        ItemId(const char *id, size_t len);
+
+        ItemId(const ItemId& other);
+        ItemId(ItemId&& other) noexcept;
+        ItemId& operator=(const ItemId& other);
+        ItemId& operator=(ItemId&& other) noexcept;
+        ~ItemId();
+
+        /**
+         * @brief Generates new random id of MAX_BYTES bytes.
+         *
+         * String representation is the same as of Crypto::generate_uuid().
+         *
+         * @return New id.
+         */
+        static ItemId generate();
+
+        /**
+         * @brief Converts id to the string, that is stored in JSON.
+         * @return Id as string.
+         */
+        std::string to_string() const;
+
+        /**
+         * @brief Creates binary id from raw bytes.
+         * @param bytes Raw bytes of the id.
+         * @param len Number of bytes. Must be between 1 and MAX_BYTES.
+         * @return New id. Empty if length is invalid.
+         */
+        static ItemId from_bytes(const unsigned char *bytes, size_t len);
+
+        /// True if id was created from an empty string.
+        bool empty() const;
+
+        /// True if id is stored as raw bytes, false if it is stored as text.
+        bool binary() const;
+
+        /// Raw bytes of binary id, or characters of text id.
+        const unsigned char *data() const;
+
+        /// Number of bytes returned by data().
+        size_t size() const;
+
+        /// Hash of the id.
+        size_t hash() const;
+
+        friend bool operator==(const ItemId& a, const ItemId& b);
+        friend bool operator!=(const ItemId& a, const ItemId& b);
+
+        /**
+         * @brief Strict ordering of ids.
+         *
+         * Binary ids are compared by their bytes and are ordered before text ids, so order is not the same as order of
+         * their string representations.
+         */
+        friend bool operator<(const ItemId& a, const ItemId& b);
+    };
+
+    bool operator==(const ItemId& a, const ItemId& b);
+    bool operator!=(const ItemId& a, const ItemId& b);
+    bool operator<(const ItemId& a, const ItemId& b);
+}
+
+namespace std {
+    /// Hash of ItemId, so it can be used as a key in unordered containers.
+    template <> struct hash<electronpass::ItemId> {
+        size_t operator()(const electronpass::ItemId& id) const {
+            return id.hash();
+        }
+    };
+}
+
 namespace electronpass {
     /**
      * @brief Class for storing and interacting with passwords.
@@ -45,11 +172,13 @@ namespace electronpass {
      * wallet are:
      *
      * - **Listing ids**: get_ids()
-     * - **Getting an item**: operator[](const std::string&) const
+     * - **Getting an item**: operator[](const ItemId&) const
      * - **Adding an item**: add_item(const Item&)
-     * - **Editing an item**: edit_item(const std::string&, const std::string&, const std::vector<Field>&) to preserve the
+     * - **Editing an item**: edit_item(const ItemId&, const std::string&, const std::vector<Field>&) to preserve the
      * id of the item being edited.
-     * - **Deleting an item**: delete_item(const std::string&)
+     * - **Deleting an item**: delete_item(const ItemId&)
+     *
+     * Ids can be passed as strings, because they are converted to ItemId implicitly.
      * - **Wallet size**: size()
      */
     class Wallet {
@@ -101,16 +230,33 @@ namespace electronpass {
              */
             Field(const std::string& name_, const std::string& value_,
                   const FieldType& field_type_, bool sensitive_): name{name_},
-                                                                  value{value_},
+                                                                  value{value_.data(), value_.size()},
                                                                   field_type{field_type_},
                                                                   sensitive{sensitive_} {}
             /// Constructor for creating an empty field.
             Field() {}
 
+            /// Copy constructor.
+            Field(const Field& other) = default;
+            /// Move constructor. Value of other is wiped.
+            Field(Field&& other) noexcept;
+            /// Copy assignment. Current value is wiped before it is replaced.
+            Field& operator=(const Field& other);
+            /// Move assignment. Current value and value of other are wiped.
+            Field& operator=(Field&& other) noexcept;
+            /// Destructor, which wipes the value.
+            ~Field();
+
             /// Display name of the field.
             std::string name;
-            /// Value that is stored in the field.
-            std::string value;
+            /**
+             * @brief Value that is stored in the field.
+             *
+             * Long values are kept in SecureArena. Short values are stored inside the field itself (see SecureString),
+             * so Field wipes its value when it is destroyed, moved from or assigned to. Wipe the value with
+             * wipe() before assigning to it directly.
+             */
+            SecureString value;
             /// Type of the field. You can read more about field types in documentation for Wallet::FieldType enum.
             FieldType field_type;
             /// Used by UI to hide sensitive information (eg. password).
@@ -124,7 +270,7 @@ namespace electronpass {
          * allowed using the class methods.
          */
         class Item {
-            std::string id;
+            ItemId id;
           public:
             /// Item fields.
             std::vector<Field> fields;
@@ -156,7 +302,7 @@ namespace electronpass {
              * @param name_ Display name for the item.
              * @param last_edited_ Unix timestamp, when the item was last edited.
              */
-            Item(const std::string& name_, std::string id_ = "", uint64_t last_edited_ = 0);
+            Item(const std::string& name_, ItemId id_ = ItemId(), uint64_t last_edited_ = 0);
 
             /**
              * @brief Constructor for creating fully populated item.
@@ -170,7 +316,8 @@ namespace electronpass {
              * @param fields_ Fields in the item. For more info about fields read Wallet::Field.
              * @param last_edited_ Unix timestamp, when the item was last edited.
              */
-            Item(const std::string& name_, const std::vector<Field>& fields_, std::string id_ = "", uint64_t last_edited_ = 0);
+            Item(const std::string& name_, const std::vector<Field>& fields_, ItemId id_ = ItemId(),
+                 uint64_t last_edited_ = 0);
 
             /// Display name for the item.
             std::string name;
@@ -181,6 +328,12 @@ namespace electronpass {
              */
             std::string get_id() const;
 
+            /**
+             * @brief Method for getting item id without converting it to string.
+             * @return Item id.
+             */
+            const ItemId& get_item_id() const;
+
             /**
              * @brief Generate new id.
              */
@@ -221,6 +374,16 @@ namespace electronpass {
          */
         Wallet(const std::map<std::string, Item>& items_, uint64_t timestamp_ = 0);
 
+        /**
+         * @brief Constructor for creating wallet populated with items, which are moved into the wallet.
+         *
+         * Items are stored under their own ids. If more items have the same id, the last one is kept.
+         *
+         * @param timestamp_ Wallet timestamp. If 0, then update_timestamp() is called.
+         * @param items_ Items that are stored in the wallet.
+         */
+        Wallet(std::vector<Item>&& items_, uint64_t timestamp_ = 0);
+
         /**
          * @brief Method for editing items.
          *
@@ -230,14 +393,23 @@ namespace electronpass {
          * @param name Changed name of the item.
          * @param fields New fields in the item.
          */
-        void edit_item(const std::string& id, const std::string& name, const std::vector<Field>& fields);
+        void edit_item(const ItemId& id, const std::string& name, const std::vector<Field>& fields);
 
         /**
          * @brief Get all ids of all the items stored in the wallet.
+         *
+         * Ids are converted to strings and sorted. Use get_item_ids() if you don't need that.
+         *
          * @return Vector of all ids.
          */
         std::vector<std::string> get_ids() const;
 
+        /**
+         * @brief Get all ids of all the items stored in the wallet without converting them to strings.
+         * @return Vector of all ids in unspecified order.
+         */
+        std::vector<ItemId> get_item_ids() const;
+
         /**
          * @brief Add item to the wallet.
          *
@@ -255,20 +427,31 @@ namespace electronpass {
          * @param id Id of the Item to be deleted.
          * @return Deleted Item.
          */
-        Item delete_item(const std::string& id);
+        Item delete_item(const ItemId& id);
 
         /**
          * @brief Get Item from the wallet
          *
          * Retrieved item is not a reference, therefore you cannot set a new item this way. For that you should use add_item(const Item&).
          * Changes done to the retrieved item are also not stored in the wallet. For that you should use
-         * edit_item(const std::string&, const std::string&, const std::vector<Field>&). This is so you cannot change the
+         * edit_item(const ItemId&, const std::string&, const std::vector<Field>&). This is so you cannot change the
          * item to a new id without changing the key in the wallet to the new id.
          *
          * @param id Id of the item.
          * @return Item in the wallet. Empty if it doesn't exist.
          */
-        Item operator[](const std::string& id) const;
+        Item operator[](const ItemId& id) const;
+
+        /**
+         * @brief Get Item from the wallet without copying it.
+         *
+         * Reference is valid until the wallet is changed. Like operator[](const ItemId&) const, it throws
+         * std::out_of_range if item doesn't exist.
+         *
+         * @param id Id of the item.
+         * @return Item in the wallet.
+         */
+        const Item& get_item(const ItemId& id) const;
 
         /**
          * @brief Get number of items in the wallet.
@@ -294,7 +477,7 @@ namespace electronpass {
         /// Date when the Wallet was saved.
         uint64_t timestamp;
     private:
-        std::map<std::string, Item> items;
+        std::unordered_map<ItemId, Item> items;
     };
 }
 
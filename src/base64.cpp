@@ -16,92 +16,257 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "crypto.hpp"
-#include <iostream>
+#include "base64_simd.hpp"
 
-static bool is_base64(unsigned char c) {
-  return (isalnum(c) || (c == '+') || (c == '/'));
-  // is alphanumeric
-}
+namespace {
+    // Index of each character in BASE64_CHARS, -1 for characters outside of Base64 alphabet.
+    const signed char DECODE_TABLE[256] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+        52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+        -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+        15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+        -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+        41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    };
 
-std::string electronpass::Crypto::base64_encode(const std::string& s) {
-    std::string result;
-    int len = s.length();
-    int s_counter = 0;
-    int i = 0;
-
-    // each 3 bytes are converted to 4 characters in Base64
-    unsigned char chars[3];
-    unsigned char new_chars[4];
-
-    while (s_counter < len) {
-        chars[i++] = s[s_counter++];
-
-        if (i == 3) {
-            new_chars[0] = (chars[0] & 0xfc) >> 2;
-            new_chars[1] = ((chars[0] & 0x03) << 4) + ((chars[1] & 0xf0) >> 4);
-            new_chars[2] = ((chars[1] & 0x0f) << 2) + ((chars[2] & 0xc0) >> 6);
-            new_chars[3] = chars[2] & 0x3f;
-
-            for (int j = 0; j < 4; ++j) result += BASE64_CHARS[new_chars[j]];
-            i = 0;
+    typedef size_t (*EncodeKernel)(const unsigned char *, size_t, char *);
+    typedef size_t (*DecodeKernel)(const char *, size_t, unsigned char *);
+
+    // Fastest vectorized kernels supported by the CPU. NULL if there are none, then only scalar code is used.
+    // CPU features are detected by sodium_init, so it has to be called first.
+    EncodeKernel encode_kernel() {
+#ifdef ELECTRONPASS_BASE64_SIMD
+        static const EncodeKernel kernel = sodium_init() == -1 ? NULL
+                                           : sodium_runtime_has_avx2() ? electronpass::base64::encode_avx2
+                                           : sodium_runtime_has_ssse3() ? electronpass::base64::encode_ssse3 : NULL;
+        return kernel;
+#else
+        return NULL;
+#endif
+    }
+
+    DecodeKernel decode_kernel() {
+#ifdef ELECTRONPASS_BASE64_SIMD
+        static const DecodeKernel kernel = sodium_init() == -1 ? NULL
+                                           : sodium_runtime_has_avx2() ? electronpass::base64::decode_avx2
+                                           : sodium_runtime_has_ssse3() ? electronpass::base64::decode_ssse3 : NULL;
+        return kernel;
+#else
+        return NULL;
+#endif
+    }
+
+    inline int decode_char(char c) {
+        return DECODE_TABLE[static_cast<unsigned char>(c)];
+    }
+
+    // Encodes whole groups of 3 bytes. Returns number of bytes encoded.
+    size_t encode_groups(const unsigned char *input, size_t len, char *output) {
+        size_t i = 0;
+        if (EncodeKernel kernel = encode_kernel()) {
+            i = kernel(input, len, output);
+            output += i / 3 * 4;
         }
+
+        for (; i + 3 <= len; i += 3, output += 4) {
+            const uint32_t triple = static_cast<uint32_t>(input[i]) << 16 | static_cast<uint32_t>(input[i + 1]) << 8 |
+                                    input[i + 2];
+            output[0] = electronpass::BASE64_CHARS[triple >> 18];
+            output[1] = electronpass::BASE64_CHARS[(triple >> 12) & 0x3f];
+            output[2] = electronpass::BASE64_CHARS[(triple >> 6) & 0x3f];
+            output[3] = electronpass::BASE64_CHARS[triple & 0x3f];
+        }
+        return i;
     }
 
-    if (i) {
-        for (int j = i; j < 3; ++j) chars[j] = '\0';
+    // Decodes whole groups of 4 characters and stops before the first group with padding or invalid characters.
+    // Returns number of characters decoded.
+    size_t decode_groups(const char *input, size_t len, unsigned char *output) {
+        size_t i = 0;
+        if (DecodeKernel kernel = decode_kernel()) {
+            i = kernel(input, len, output);
+            output += i / 4 * 3;
+        }
 
-        new_chars[0] = (chars[0] & 0xfc) >> 2;
-        new_chars[1] = ((chars[0] & 0x03) << 4) + ((chars[1] & 0xf0) >> 4);
-        new_chars[2] = ((chars[1] & 0x0f) << 2) + ((chars[2] & 0xc0) >> 6);
-        new_chars[3] = chars[2] & 0x3f;
+        for (; i + 4 <= len; i += 4, output += 3) {
+            const int a = decode_char(input[i]), b = decode_char(input[i + 1]);
+            const int c = decode_char(input[i + 2]), d = decode_char(input[i + 3]);
+            if ((a | b | c | d) < 0) break;
 
-        for (int j = 0; j < i + 1; ++j) result += BASE64_CHARS[new_chars[j]];
+            const uint32_t triple = static_cast<uint32_t>(a) << 18 | static_cast<uint32_t>(b) << 12 |
+                                    static_cast<uint32_t>(c) << 6 | static_cast<uint32_t>(d);
+            output[0] = static_cast<unsigned char>(triple >> 16);
+            output[1] = static_cast<unsigned char>(triple >> 8);
+            output[2] = static_cast<unsigned char>(triple);
+        }
+        return i;
+    }
 
-        while (i++ < 3) result += '=';
+    // Decodes one group of 4 characters, which can end with padding. Returns false if group is invalid.
+    bool decode_group(const char *group, unsigned char *output, size_t& output_len, bool& padded) {
+        const size_t padding = group[3] != '=' ? 0 : group[2] != '=' ? 1 : 2;
+        const int a = decode_char(group[0]), b = decode_char(group[1]);
+        const int c = padding >= 2 ? 0 : decode_char(group[2]);
+        const int d = padding >= 1 ? 0 : decode_char(group[3]);
+        if ((a | b | c | d) < 0) return false;
 
-     }
+        const uint32_t triple = static_cast<uint32_t>(a) << 18 | static_cast<uint32_t>(b) << 12 |
+                                static_cast<uint32_t>(c) << 6 | static_cast<uint32_t>(d);
+        // Bits after the last byte must be zero, so each data has only one encoding.
+        if ((triple & ((1u << (8 * padding)) - 1)) != 0) return false;
 
-     return result;
+        output[0] = static_cast<unsigned char>(triple >> 16);
+        if (padding < 2) output[1] = static_cast<unsigned char>(triple >> 8);
+        if (padding < 1) output[2] = static_cast<unsigned char>(triple);
+        output_len = 3 - padding;
+        padded = padding > 0;
+        return true;
+    }
 }
 
+const size_t electronpass::Base64Encoder::FINISH_BYTES;
 
-std::string electronpass::Crypto::base64_decode(const std::string& s) {
-    // String is not correctly encoded in Base64.
-    if (s.size() % 4 != 0) return "";
+size_t electronpass::Base64Encoder::update(const unsigned char *input, size_t len, char *output) {
+    size_t output_len = 0;
 
-    std::string result;
-    int len = s.size();
-    int i = 0, counter = 0;
-    unsigned char chars[4];
-    unsigned char new_chars[3];
+    // Complete group from the previous chunk.
+    if (pending_len > 0) {
+        while (pending_len < 3 && len > 0) {
+            pending[pending_len++] = *input++;
+            --len;
+        }
+        if (pending_len < 3) return 0;
+        output_len += encode_groups(pending, 3, output) / 3 * 4;
+        pending_len = 0;
+    }
 
-    while ((counter < len) && (s[counter] != '=') && is_base64(s[counter])) {
-        chars[i++] = s[counter++];
+    const size_t encoded = encode_groups(input, len, output + output_len);
+    output_len += encoded / 3 * 4;
 
-        if (i == 4) {
-            // find indices
-            for (int j = 0; j < 4; ++j) chars[j] = BASE64_CHARS.find(chars[j]);
+    // Keep the rest for the next chunk.
+    for (size_t i = encoded; i < len; ++i) pending[pending_len++] = input[i];
+    return output_len;
+}
 
-            new_chars[0] = (chars[0] << 2) + ((chars[1] & 0x30) >> 4);
-            new_chars[1] = ((chars[1] & 0x0f) << 4) + ((chars[2] & 0x3c) >> 2);
-            new_chars[2] = ((chars[2] & 0x03) << 6) + chars[3];
+size_t electronpass::Base64Encoder::finish(char *output) {
+    if (pending_len == 0) return 0;
 
-            for (i = 0; (i < 3); i++) result += new_chars[i];
-            i = 0;
-        }
+    // Last 1 or 2 bytes are padded with '='.
+    const uint32_t rest = static_cast<uint32_t>(pending[0]) << 16 |
+                          (pending_len > 1 ? static_cast<uint32_t>(pending[1]) << 8 : 0);
+    output[0] = BASE64_CHARS[rest >> 18];
+    output[1] = BASE64_CHARS[(rest >> 12) & 0x3f];
+    output[2] = pending_len > 1 ? BASE64_CHARS[(rest >> 6) & 0x3f] : '=';
+    output[3] = '=';
+    pending_len = 0;
+    return 4;
+}
+
+size_t electronpass::Base64Encoder::max_output_size(size_t len) {
+    // Up to 2 bytes can be left from the previous chunk.
+    return (len + 2) / 3 * 4;
+}
+
+bool electronpass::Base64Decoder::decode(const char *input, size_t len, unsigned char *output,
+                                         size_t& output_len) {
+    // Length is a multiple of 4. Fast path decodes everything until padding or an invalid character.
+    size_t i = 0;
+    while (i < len) {
+        if (padded) return false;
+
+        const size_t decoded = decode_groups(input + i, len - i, output + output_len);
+        i += decoded;
+        output_len += decoded / 4 * 3;
+        if (i == len) break;
+
+        size_t written;
+        if (!decode_group(input + i, output + output_len, written, padded)) return false;
+        i += 4;
+        output_len += written;
     }
+    return true;
+}
 
-    if (i) {
-        for (int j = i; j < 4; ++j) chars[j] = 0;
+bool electronpass::Base64Decoder::update(const char *input, size_t len, unsigned char *output,
+                                         size_t& output_len) {
+    output_len = 0;
+    if (failed) return false;
+    if (len == 0) return true;
 
-        for (int j = 0; j < 4; ++j) chars[j] = BASE64_CHARS.find(chars[j]);
+    // Complete group from the previous chunk.
+    if (pending_len > 0) {
+        while (pending_len < 4 && len > 0) {
+            pending[pending_len++] = *input++;
+            --len;
+        }
+        if (pending_len < 4) return true;
+        pending_len = 0;
+        if (!decode(pending, 4, output, output_len)) {
+            failed = true;
+            return false;
+        }
+    }
 
-        new_chars[0] = (chars[0] << 2) + ((chars[1] & 0x30) >> 4);
-        new_chars[1] = ((chars[1] & 0x0f) << 4) + ((chars[2] & 0x3c) >> 2);
-        new_chars[2] = ((chars[2] & 0x03) << 6) + chars[3];
+    const size_t whole = len / 4 * 4;
+    if (!decode(input, whole, output, output_len)) {
+        failed = true;
+        return false;
+    }
 
-        for (int j = 0; j < i - 1; ++j) result += new_chars[j];
+    // Keep the rest for the next chunk. Nothing can follow padding.
+    for (size_t i = whole; i < len; ++i) pending[pending_len++] = input[i];
+    if (padded && pending_len > 0) {
+        failed = true;
+        return false;
     }
+    return true;
+}
+
+bool electronpass::Base64Decoder::finish() {
+    const bool success = !failed && pending_len == 0;
+    pending_len = 0;
+    padded = false;
+    failed = false;
+    return success;
+}
 
+size_t electronpass::Base64Decoder::max_output_size(size_t len) {
+    // Up to 3 characters can be left from the previous chunk.
+    return (len + 3) / 4 * 3;
+}
+
+std::string electronpass::Crypto::base64_encode(const std::string& s) {
+    // Output is allocated only once.
+    std::string result((s.size() + 2) / 3 * 4, '\0');
+    if (s.empty()) return result;
+
+    Base64Encoder encoder;
+    const size_t len = encoder.update(reinterpret_cast<const unsigned char *>(s.data()), s.size(), &result[0]);
+    encoder.finish(&result[len]);
+    return result;
+}
+
+std::string electronpass::Crypto::base64_decode(const std::string& s) {
+    // String is not correctly encoded in Base64.
+    if (s.size() % 4 != 0 || s.empty()) return "";
+
+    std::string result(Base64Decoder::max_output_size(s.size()), '\0');
+    Base64Decoder decoder;
+    size_t len;
+    if (!decoder.update(s.data(), s.size(), reinterpret_cast<unsigned char *>(&result[0]), len) ||
+        !decoder.finish()) {
+        return "";
+    }
+    result.resize(len);
     return result;
 }
@@ -0,0 +1,159 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "base64_simd.hpp"
+
+#ifdef ELECTRONPASS_BASE64_SIMD
+
+#include <immintrin.h>
+
+// Kernels follow vectorized Base64 algorithms by Wojciech Muła and Daniel Lemire. Bytes are split into 6-bit indices
+// with a shuffle and two multiplications, and indices are translated to characters (and back) with nibble lookup
+// tables. AVX2 versions do the same as SSSE3 versions in each 128-bit lane.
+
+// Bytes of each 12-byte group, reordered so each 32-bit word holds 3 bytes in the order needed for splitting.
+#define kEncodeShuffle 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+// Offset from index to character. Row is chosen by range of the index (A-Z, a-z, 0-9, + or /).
+#define kEncodeOffsets 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+                       '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+
+// Classes of low and high nibbles of characters. Character is valid if its classes have no common bit.
+#define kDecodeLowNibbles 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+#define kDecodeHighNibbles 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+// Offset from character to index by its high nibble ('/' is moved to its own row).
+#define kDecodeOffsets 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+// Decoded bytes of each 32-bit word, packed to the beginning of the lane.
+#define kDecodeShuffle 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+__attribute__((target("ssse3")))
+static inline __m128i encode_block_ssse3(__m128i input) {
+    input = _mm_shuffle_epi8(input, _mm_setr_epi8(kEncodeShuffle));
+    const __m128i indices = _mm_or_si128(
+        _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)),
+        _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(_mm_setr_epi8(kEncodeOffsets), range), indices);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i encode_block_avx2(__m256i input) {
+    input = _mm256_shuffle_epi8(input, _mm256_broadcastsi128_si256(_mm_setr_epi8(kEncodeShuffle)));
+    const __m256i indices = _mm256_or_si256(
+        _mm256_mulhi_epu16(_mm256_and_si256(input, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040)),
+        _mm256_mullo_epi16(_mm256_and_si256(input, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010)));
+
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices),
+                                                    _mm256_set1_epi8(13)));
+    const __m256i offsets = _mm256_broadcastsi128_si256(_mm_setr_epi8(kEncodeOffsets));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+}
+
+// Translates characters to indices and packs them to bytes. Returns false if block contains invalid characters.
+__attribute__((target("ssse3")))
+static inline bool decode_block_ssse3(__m128i input, __m128i& output) {
+    const __m128i high_nibbles = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0f));
+    const __m128i low_nibbles = _mm_and_si128(input, _mm_set1_epi8(0x0f));
+    const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(_mm_setr_epi8(kDecodeLowNibbles), low_nibbles),
+                                          _mm_shuffle_epi8(_mm_setr_epi8(kDecodeHighNibbles), high_nibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xffff) return false;
+
+    const __m128i row = _mm_add_epi8(_mm_cmpeq_epi8(input, _mm_set1_epi8('/')), high_nibbles);
+    const __m128i indices = _mm_add_epi8(input, _mm_shuffle_epi8(_mm_setr_epi8(kDecodeOffsets), row));
+
+    const __m128i pairs = _mm_maddubs_epi16(indices, _mm_set1_epi32(0x01400140));
+    const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    output = _mm_shuffle_epi8(words, _mm_setr_epi8(kDecodeShuffle));
+    return true;
+}
+
+__attribute__((target("avx2")))
+static inline bool decode_block_avx2(__m256i input, __m256i& output) {
+    const __m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi32(input, 4), _mm256_set1_epi8(0x0f));
+    const __m256i low_nibbles = _mm256_and_si256(input, _mm256_set1_epi8(0x0f));
+    const __m256i low_classes = _mm256_broadcastsi128_si256(_mm_setr_epi8(kDecodeLowNibbles));
+    const __m256i high_classes = _mm256_broadcastsi128_si256(_mm_setr_epi8(kDecodeHighNibbles));
+    const __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(low_classes, low_nibbles),
+                                             _mm256_shuffle_epi8(high_classes, high_nibbles));
+    if (!_mm256_testz_si256(invalid, invalid)) return false;
+
+    const __m256i row = _mm256_add_epi8(_mm256_cmpeq_epi8(input, _mm256_set1_epi8('/')), high_nibbles);
+    const __m256i offsets = _mm256_broadcastsi128_si256(_mm_setr_epi8(kDecodeOffsets));
+    const __m256i indices = _mm256_add_epi8(input, _mm256_shuffle_epi8(offsets, row));
+
+    const __m256i pairs = _mm256_maddubs_epi16(indices, _mm256_set1_epi32(0x01400140));
+    const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i packed = _mm256_shuffle_epi8(words, _mm256_broadcastsi128_si256(_mm_setr_epi8(kDecodeShuffle)));
+    // Join 12 bytes of both lanes.
+    output = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    return true;
+}
+
+__attribute__((target("ssse3")))
+size_t electronpass::base64::encode_ssse3(const unsigned char *input, size_t len, char *output) {
+    size_t i = 0;
+    // 16 bytes are loaded for each 12 bytes of input.
+    for (; i + 16 <= len; i += 12, output += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output), encode_block_ssse3(block));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t electronpass::base64::encode_avx2(const unsigned char *input, size_t len, char *output) {
+    size_t i = 0;
+    // Each lane loads 16 bytes for its 12 bytes of input.
+    for (; i + 28 <= len; i += 24, output += 32) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 12));
+        const __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), encode_block_avx2(block));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+size_t electronpass::base64::decode_ssse3(const char *input, size_t len, unsigned char *output) {
+    size_t i = 0;
+    // Each block stores 16 bytes, but only 12 of them are decoded. Following 8 characters (at least 4 bytes, even
+    // with padding) make sure the store doesn't go past the end of output.
+    for (; i + 24 <= len; i += 16, output += 12) {
+        __m128i decoded;
+        if (!decode_block_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i)), decoded)) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output), decoded);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t electronpass::base64::decode_avx2(const char *input, size_t len, unsigned char *output) {
+    size_t i = 0;
+    // Each block stores 32 bytes, but only 24 of them are decoded. Following 16 characters (at least 10 bytes) make
+    // sure the store doesn't go past the end of output.
+    for (; i + 48 <= len; i += 32, output += 24) {
+        __m256i decoded;
+        if (!decode_block_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i)), decoded)) break;
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), decoded);
+    }
+    return i;
+}
+
+#endif // ELECTRONPASS_BASE64_SIMD
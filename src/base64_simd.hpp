@@ -0,0 +1,47 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELECTRONPASS_BASE64_SIMD_HPP
+#define ELECTRONPASS_BASE64_SIMD_HPP
+
+#include <cstddef>
+
+// Internal vectorized Base64 kernels. They are only compiled for x86 with GCC or Clang, which can enable instruction
+// sets per function, and are selected at runtime by Crypto::base64_encode() and Crypto::base64_decode().
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ELECTRONPASS_BASE64_SIMD 1
+#endif
+
+#ifdef ELECTRONPASS_BASE64_SIMD
+namespace electronpass {
+    namespace base64 {
+        // Encoders encode whole blocks (12 or 24 bytes) from the beginning of input and return number of input bytes
+        // encoded. Output must have room for 4/3 of that. Rest of input is left to scalar code.
+        size_t encode_ssse3(const unsigned char *input, size_t len, char *output);
+        size_t encode_avx2(const unsigned char *input, size_t len, char *output);
+
+        // Decoders decode whole blocks (16 or 32 characters) and stop before the first block, which contains
+        // anything else than Base64 alphabet (padding or invalid characters). Return number of characters decoded.
+        // Output must have room for 3/4 of input length.
+        size_t decode_ssse3(const char *input, size_t len, unsigned char *output);
+        size_t decode_avx2(const char *input, size_t len, unsigned char *output);
+    }
+}
+#endif
+
+#endif // ELECTRONPASS_BASE64_SIMD_HPP
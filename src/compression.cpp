@@ -0,0 +1,240 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "compression.hpp"
+#include <cstring>
+#include <vector>
+
+#ifdef ELECTRONPASS_ZLIB
+#include <zlib.h>
+#endif
+
+#define kSizeBytes 8
+
+// LZ4 block format: matches are at least 4 bytes long, last match starts at least 12 bytes before the end and last
+// 5 bytes are always literals.
+#define kLzMinMatch 4
+#define kLzMatchLimit 12
+#define kLzLastLiterals 5
+#define kLzMaxOffset 65535
+#define kLzHashBits 14
+// Each byte of LZ data can produce at most 255 bytes of output.
+#define kLzMaxRatio 255
+
+// Maximum compression ratio of deflate.
+#define kZlibMaxRatio 1032
+
+using electronpass::serialization::Compression;
+
+namespace {
+    uint32_t read32(const unsigned char *p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof value);
+        return value;
+    }
+
+    uint32_t lz_hash(uint32_t sequence) {
+        return (sequence * 2654435761U) >> (32 - kLzHashBits);
+    }
+
+    size_t lz_bound(size_t len) {
+        return len + len / 255 + 16;
+    }
+
+    // Writes length, that didn't fit into the token, as a sequence of bytes, which are added together.
+    void lz_write_length(unsigned char *&out, size_t len) {
+        for (; len >= 255; len -= 255) *out++ = 255;
+        *out++ = static_cast<unsigned char>(len);
+    }
+
+    void lz_write_sequence(unsigned char *&out, const unsigned char *literals, size_t literals_len, size_t offset,
+                           size_t match_len) {
+        unsigned char *token = out++;
+        *token = static_cast<unsigned char>((literals_len >= 15 ? 15 : literals_len) << 4);
+        if (literals_len >= 15) lz_write_length(out, literals_len - 15);
+        std::memcpy(out, literals, literals_len);
+        out += literals_len;
+        if (match_len == 0) return;
+
+        *out++ = static_cast<unsigned char>(offset & 0xff);
+        *out++ = static_cast<unsigned char>(offset >> 8);
+        match_len -= kLzMinMatch;
+        *token |= static_cast<unsigned char>(match_len >= 15 ? 15 : match_len);
+        if (match_len >= 15) lz_write_length(out, match_len - 15);
+    }
+
+    // Greedy LZ77 with a hash table of the last position of each 4 byte sequence. Returns compressed size.
+    size_t lz_compress(const unsigned char *in, size_t len, unsigned char *out) {
+        unsigned char *const out_start = out;
+        size_t anchor = 0;
+
+        if (len > kLzMatchLimit) {
+            std::vector<uint32_t> table(1 << kLzHashBits, 0);
+            const size_t match_start_limit = len - kLzMatchLimit;
+            const size_t match_end_limit = len - kLzLastLiterals;
+
+            size_t position = 0;
+            while (position < match_start_limit) {
+                const uint32_t sequence = read32(in + position);
+                const uint32_t hash = lz_hash(sequence);
+                const size_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(position);
+
+                if (candidate >= position || position - candidate > kLzMaxOffset || read32(in + candidate) != sequence) {
+                    // Data without matches is skipped faster.
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                size_t match_len = kLzMinMatch;
+                while (position + match_len < match_end_limit && in[candidate + match_len] == in[position + match_len]) {
+                    ++match_len;
+                }
+                lz_write_sequence(out, in + anchor, position - anchor, position - candidate, match_len);
+                position += match_len;
+                anchor = position;
+            }
+        }
+
+        lz_write_sequence(out, in + anchor, len - anchor, 0, 0);
+        return static_cast<size_t>(out - out_start);
+    }
+
+    bool lz_read_length(const unsigned char *&in, const unsigned char *end, size_t& len) {
+        unsigned char byte;
+        do {
+            if (in == end) return false;
+            byte = *in++;
+            len += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // Decompresses into output of exactly out_len bytes. Every length and offset is checked against both buffers.
+    bool lz_decompress(const unsigned char *in, size_t len, unsigned char *out, size_t out_len) {
+        const unsigned char *const in_end = in + len;
+        size_t written = 0;
+
+        while (in < in_end) {
+            const unsigned char token = *in++;
+
+            size_t literals_len = token >> 4;
+            if (literals_len == 15 && !lz_read_length(in, in_end, literals_len)) return false;
+            if (literals_len > static_cast<size_t>(in_end - in) || literals_len > out_len - written) return false;
+            std::memcpy(out + written, in, literals_len);
+            in += literals_len;
+            written += literals_len;
+
+            // Last sequence has only literals.
+            if (in == in_end) break;
+
+            if (in_end - in < 2) return false;
+            const size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+            in += 2;
+            if (offset == 0 || offset > written) return false;
+
+            size_t match_len = token & 0x0f;
+            if (match_len == 15 && !lz_read_length(in, in_end, match_len)) return false;
+            match_len += kLzMinMatch;
+            if (match_len > out_len - written) return false;
+
+            // Match can overlap with bytes, that it is copying, so it is copied byte by byte.
+            const unsigned char *match = out + written - offset;
+            for (size_t i = 0; i < match_len; ++i) out[written + i] = match[i];
+            written += match_len;
+        }
+
+        return written == out_len;
+    }
+
+    void write_size(unsigned char *out, uint64_t size) {
+        for (int i = 0; i < kSizeBytes; ++i) out[i] = static_cast<unsigned char>(size >> (8 * i));
+    }
+
+    uint64_t read_size(const unsigned char *in) {
+        uint64_t size = 0;
+        for (int i = 0; i < kSizeBytes; ++i) size |= static_cast<uint64_t>(in[i]) << (8 * i);
+        return size;
+    }
+}
+
+bool electronpass::compression::available(Compression compression) {
+    switch (compression) {
+        case Compression::LZ:
+            return true;
+#ifdef ELECTRONPASS_ZLIB
+        case Compression::ZLIB:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool electronpass::compression::compress(Compression compression, const char *data, size_t len,
+                                         SecureString& output) {
+    if (!available(compression)) return false;
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(data);
+
+    if (compression == Compression::LZ) {
+        output.assign(kSizeBytes + lz_bound(len), '\0');
+        unsigned char *out = reinterpret_cast<unsigned char *>(&output[0]);
+        write_size(out, len);
+        output.resize(kSizeBytes + lz_compress(in, len, out + kSizeBytes));
+        return true;
+    }
+
+#ifdef ELECTRONPASS_ZLIB
+    uLongf compressed_len = compressBound(static_cast<uLong>(len));
+    output.assign(kSizeBytes + compressed_len, '\0');
+    unsigned char *out = reinterpret_cast<unsigned char *>(&output[0]);
+    write_size(out, len);
+    if (compress2(out + kSizeBytes, &compressed_len, in, static_cast<uLong>(len), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    output.resize(kSizeBytes + compressed_len);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool electronpass::compression::decompress(Compression compression, const char *data, size_t len,
+                                           SecureString& output, size_t max_size) {
+    if (!available(compression) || len < kSizeBytes) return false;
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(data) + kSizeBytes;
+    const size_t in_len = len - kSizeBytes;
+
+    // Declared size is checked before output is allocated.
+    const uint64_t size = read_size(reinterpret_cast<const unsigned char *>(data));
+    const uint64_t max_ratio = compression == Compression::LZ ? kLzMaxRatio : kZlibMaxRatio;
+    if (size > max_size || size > static_cast<uint64_t>(in_len) * max_ratio) return false;
+
+    output.assign(static_cast<size_t>(size), '\0');
+    unsigned char *out = reinterpret_cast<unsigned char *>(&output[0]);
+
+    if (compression == Compression::LZ) return lz_decompress(in, in_len, out, output.size());
+
+#ifdef ELECTRONPASS_ZLIB
+    uLongf out_len = static_cast<uLongf>(size);
+    // Output buffer is full before data is, if data would decompress to more than declared size.
+    return uncompress(out, &out_len, in, static_cast<uLong>(in_len)) == Z_OK && out_len == size;
+#else
+    return false;
+#endif
+}
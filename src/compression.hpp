@@ -0,0 +1,46 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELECTRONPASS_COMPRESSION_HPP
+#define ELECTRONPASS_COMPRESSION_HPP
+
+#include <string>
+#include "serialization.hpp"
+#include "secure_memory.hpp"
+
+// Internal compression of wallet payload. Compressed data starts with the size of uncompressed data (8 bytes,
+// little-endian), followed by data in the format of the codec. Declared size is checked before anything is
+// decompressed, so corrupted or malicious data can't make decompression allocate more than the caller allows.
+
+namespace electronpass {
+    namespace compression {
+        // Checks if codec is compiled in. NONE is not a codec.
+        bool available(serialization::Compression compression);
+
+        // Compresses data. Output is allocated once, with the size of the worst case, so it is never reallocated.
+        // Output must still be wiped by the caller (see SecureString).
+        bool compress(serialization::Compression compression, const char *data, size_t len, SecureString& output);
+
+        // Decompresses data. Fails if declared size is larger than max_size or than codec can produce from the data,
+        // or if data doesn't decompress to exactly declared size.
+        bool decompress(serialization::Compression compression, const char *data, size_t len, SecureString& output,
+                        size_t max_size);
+    }
+}
+
+#endif // ELECTRONPASS_COMPRESSION_HPP
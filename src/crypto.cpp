@@ -16,85 +16,253 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "crypto.hpp"
+#include "random.hpp"
+#include <algorithm>
+
+const size_t electronpass::Crypto::NONCE_BYTES;
+const size_t electronpass::Crypto::OVERHEAD_BYTES;
+const size_t electronpass::Crypto::WRAPPED_KEY_BYTES;
+const size_t electronpass::Crypto::KEY_CHECK_BYTES;
+const size_t electronpass::Crypto::PUBLIC_KEY_BYTES;
+const size_t electronpass::Crypto::SEALED_KEY_BYTES;
+const size_t electronpass::Crypto::SIGNING_PUBLIC_KEY_BYTES;
+const size_t electronpass::Crypto::SIGNATURE_BYTES;
+
+// Message, which is hashed with the key to get key check value.
+#define kKeyCheckMessage "electronpass key check"
+
+electronpass::DerivedKey::DerivedKey(unsigned char *key_, const KdfParams& params_): key{key_}, params(params_) {
+    if (key != NULL) sodium_mprotect_noaccess(key);
+}
+
+electronpass::DerivedKey::DerivedKey(DerivedKey&& other): key{other.key}, params(std::move(other.params)) {
+    other.key = NULL;
+}
+
+electronpass::DerivedKey& electronpass::DerivedKey::operator=(DerivedKey&& other) {
+    if (this != &other) {
+        // sodium_free wipes memory before freeing it.
+        if (key != NULL) sodium_free(key);
+        key = other.key;
+        params = std::move(other.params);
+        other.key = NULL;
+    }
+    return *this;
+}
+
+electronpass::DerivedKey::~DerivedKey() {
+    if (key != NULL) sodium_free(key);
+}
 
-electronpass::Crypto::Crypto(std::string password) {
-    bool part_success = false;
+bool electronpass::DerivedKey::check() const {
+    return key != NULL;
+}
+
+const electronpass::KdfParams& electronpass::DerivedKey::kdf_params() const {
+    return params;
+}
+
+electronpass::Crypto::Crypto(std::string password): params(KdfParams::legacy()) {
     // Sodium init returns 0 if everything is ok and 1 if sodium was already initialized.
-    if (sodium_init() != -1) part_success = true;
+    sodium_success = sodium_init() != -1 && generate_key(password.data(), password.length(), params, key);
+}
 
-    unsigned int password_len = password.length();
-    char *password_char = new char[password_len];
+electronpass::Crypto::Crypto(const std::string& password, const KdfParams& kdf_params): params(kdf_params) {
+    sodium_success = sodium_init() != -1 && generate_key(password.data(), password.length(), params, key);
+}
 
-    for (unsigned int i = 0; i < password_len; ++i) password_char[i] = password[i];
+electronpass::Crypto::Crypto(const DerivedKey& derived_key): params(derived_key.params) {
+    sodium_success = derived_key.check();
+    if (!sodium_success) return;
 
-    part_success &= generate_key(password_char, password_len);
-    sodium_success = part_success;
+    sodium_mprotect_readonly(derived_key.key);
+    std::copy(derived_key.key, derived_key.key + sizeof key, key);
+    sodium_mprotect_noaccess(derived_key.key);
+}
 
-    delete[] password_char;
+electronpass::Crypto::~Crypto() {
+    sodium_memzero(key, sizeof key);
 }
 
+const electronpass::KdfParams& electronpass::Crypto::kdf_params() const {
+    return params;
+}
 
-bool electronpass::Crypto::generate_key(const char* password, unsigned int password_len) {
-    // Generates 32 bytes key for encryption.
-    // Salt is a constant, but we are generating a random nonce for every encrypton.
-    if (crypto_pwhash_scryptsalsa208sha256(key, sizeof key, password, password_len, CRYPTO_SALT,
-            crypto_pwhash_scryptsalsa208sha256_OPSLIMIT_INTERACTIVE,
-            crypto_pwhash_scryptsalsa208sha256_MEMLIMIT_INTERACTIVE) != 0) {
-        return false;
+electronpass::DerivedKey electronpass::Crypto::derive_key(const std::string& password, const KdfParams& kdf_params) {
+    return derive_key(password.data(), password.length(), kdf_params);
+}
+
+electronpass::DerivedKey electronpass::Crypto::derive_key(const char *password, size_t password_len,
+                                                          const KdfParams& kdf_params) {
+    if (sodium_init() == -1) return DerivedKey(NULL, kdf_params);
+
+    unsigned char *key = static_cast<unsigned char *>(sodium_malloc(crypto_box_SEEDBYTES));
+    if (key == NULL) return DerivedKey(NULL, kdf_params);
+
+    if (!generate_key(password, password_len, kdf_params, key)) {
+        sodium_free(key);
+        return DerivedKey(NULL, kdf_params);
     }
-    return true;
+    return DerivedKey(key, kdf_params);
 }
 
-std::string electronpass::Crypto::encrypt(const std::string& plain_text, bool& success) const {
-    if (!check()) {
-        success = false;
-        return "";
+electronpass::DerivedKey electronpass::Crypto::generate_data_key() const {
+    if (!check()) return DerivedKey(NULL, KdfParams());
+    return generate_random_key();
+}
+
+electronpass::DerivedKey electronpass::Crypto::generate_random_key() {
+    if (sodium_init() == -1) return DerivedKey(NULL, KdfParams());
+
+    unsigned char *key = static_cast<unsigned char *>(sodium_malloc(crypto_box_SEEDBYTES));
+    if (key == NULL) return DerivedKey(NULL, KdfParams());
+
+    randombytes_buf(key, crypto_box_SEEDBYTES);
+    return DerivedKey(key, KdfParams());
+}
+
+bool electronpass::Crypto::wrap_key(const DerivedKey& data_key, unsigned char *wrapped,
+                                    const unsigned char *additional_data, size_t additional_data_len) const {
+    if (!check() || !data_key.check()) return false;
+
+    const size_t nonce_len = nonce_size(Cipher::XCHACHA20_POLY1305);
+    Random::bytes(wrapped, nonce_len);
+
+    sodium_mprotect_readonly(data_key.key);
+    const bool success = aead_encrypt(data_key.key, crypto_box_SEEDBYTES, wrapped + nonce_len,
+                                      additional_data, additional_data_len, wrapped, Cipher::XCHACHA20_POLY1305);
+    sodium_mprotect_noaccess(data_key.key);
+    return success;
+}
+
+electronpass::DerivedKey electronpass::Crypto::unwrap_key(const unsigned char *wrapped, size_t wrapped_len,
+                                                          const unsigned char *additional_data,
+                                                          size_t additional_data_len) const {
+    if (!check() || wrapped_len != WRAPPED_KEY_BYTES) return DerivedKey(NULL, KdfParams());
+
+    unsigned char *data_key = static_cast<unsigned char *>(sodium_malloc(crypto_box_SEEDBYTES));
+    if (data_key == NULL) return DerivedKey(NULL, KdfParams());
+
+    const size_t nonce_len = nonce_size(Cipher::XCHACHA20_POLY1305);
+    if (!aead_decrypt(wrapped + nonce_len, wrapped_len - nonce_len, data_key, additional_data, additional_data_len,
+                      wrapped, Cipher::XCHACHA20_POLY1305)) {
+        sodium_free(data_key);
+        return DerivedKey(NULL, KdfParams());
     }
-    // Convert std::string to unsigned char array.
-    const unsigned int message_len = plain_text.length();
-    unsigned char *message = new unsigned char[message_len];
+    return DerivedKey(data_key, KdfParams());
+}
 
-    // Copy string with for loop, just in case there is a '\0' char in plain_text.
-    for (unsigned int i = 0; i < message_len; ++i) message[i] = plain_text[i];
+electronpass::DerivedKey electronpass::Crypto::generate_key_pair(unsigned char *public_key) {
+    if (sodium_init() == -1) return DerivedKey(NULL, KdfParams());
 
-    // Allocate memory for encrypted message.
-    // Additional ChaCha20 - Poly1305 bytes are needed for authentication.
-    unsigned char *cipher_text = new unsigned char[message_len + crypto_aead_chacha20poly1305_ABYTES];
-    unsigned long long cipher_text_len;
+    unsigned char *secret_key = static_cast<unsigned char *>(sodium_malloc(crypto_box_SECRETKEYBYTES));
+    if (secret_key == NULL) return DerivedKey(NULL, KdfParams());
 
-    // Generate ranodom nonce. It will be added at the begining of encrypted data.
-    // (Same nonce should never be reused with same key, that's why we are generating a random one.)
-    unsigned int nonce_size = crypto_aead_chacha20poly1305_NPUBBYTES;  // 8 bytes
-    unsigned char *nonce = new unsigned char[nonce_size];
-    randombytes_buf(nonce, sizeof nonce);
+    crypto_box_keypair(public_key, secret_key);
+    return DerivedKey(secret_key, KdfParams());
+}
 
-    // Actual enctyption.
-    success = (crypto_aead_chacha20poly1305_encrypt(cipher_text, &cipher_text_len,
-                                                    message, message_len,
-                                                    NULL, 0, NULL, nonce, key) == 0);
+bool electronpass::Crypto::seal_key(const DerivedKey& data_key, const unsigned char *public_key,
+                                    unsigned char *sealed) {
+    if (!data_key.check()) return false;
 
-    delete[] message;
+    sodium_mprotect_readonly(data_key.key);
+    const bool success = crypto_box_seal(sealed, data_key.key, crypto_box_SEEDBYTES, public_key) == 0;
+    sodium_mprotect_noaccess(data_key.key);
+    return success;
+}
 
+electronpass::DerivedKey electronpass::Crypto::open_sealed_key(const unsigned char *sealed, size_t sealed_len,
+                                                               const unsigned char *public_key,
+                                                               const DerivedKey& secret_key) {
+    if (!secret_key.check() || sealed_len != SEALED_KEY_BYTES) return DerivedKey(NULL, KdfParams());
+
+    unsigned char *data_key = static_cast<unsigned char *>(sodium_malloc(crypto_box_SEEDBYTES));
+    if (data_key == NULL) return DerivedKey(NULL, KdfParams());
+
+    sodium_mprotect_readonly(secret_key.key);
+    const bool success = crypto_box_seal_open(data_key, sealed, sealed_len, public_key, secret_key.key) == 0;
+    sodium_mprotect_noaccess(secret_key.key);
     if (!success) {
-        // probabbly key was not generated or system random is not actual random.
-        delete[] cipher_text;
-        delete[] nonce;
+        sodium_free(data_key);
+        return DerivedKey(NULL, KdfParams());
+    }
+    return DerivedKey(data_key, KdfParams());
+}
+
+electronpass::DerivedKey electronpass::Crypto::generate_signing_key_pair(unsigned char *public_key) {
+    if (sodium_init() == -1) return DerivedKey(NULL, KdfParams());
+
+    unsigned char *seed = static_cast<unsigned char *>(sodium_malloc(crypto_sign_SEEDBYTES));
+    unsigned char *secret_key = static_cast<unsigned char *>(sodium_malloc(crypto_sign_SECRETKEYBYTES));
+    if (seed == NULL || secret_key == NULL) {
+        sodium_free(seed);
+        sodium_free(secret_key);
+        return DerivedKey(NULL, KdfParams());
+    }
+
+    randombytes_buf(seed, crypto_sign_SEEDBYTES);
+    crypto_sign_seed_keypair(public_key, secret_key, seed);
+    sodium_free(secret_key);
+    return DerivedKey(seed, KdfParams());
+}
+
+bool electronpass::Crypto::sign(const unsigned char *message, size_t message_len, const DerivedKey& signing_key,
+                                unsigned char *signature) {
+    if (!signing_key.check()) return false;
+
+    // Only the seed is stored, full secret key is expanded from it for every signature.
+    unsigned char *secret_key = static_cast<unsigned char *>(sodium_malloc(crypto_sign_SECRETKEYBYTES));
+    if (secret_key == NULL) return false;
+    unsigned char public_key[crypto_sign_PUBLICKEYBYTES];
+
+    sodium_mprotect_readonly(signing_key.key);
+    crypto_sign_seed_keypair(public_key, secret_key, signing_key.key);
+    sodium_mprotect_noaccess(signing_key.key);
+
+    const bool success = crypto_sign_detached(signature, NULL, message, message_len, secret_key) == 0;
+    sodium_free(secret_key);
+    return success;
+}
+
+bool electronpass::Crypto::verify_signature(const unsigned char *message, size_t message_len,
+                                            const unsigned char *signature, const unsigned char *public_key) {
+    if (sodium_init() == -1) return false;
+    return crypto_sign_verify_detached(signature, message, message_len, public_key) == 0;
+}
+
+std::string electronpass::Crypto::key_check() const {
+    if (!check()) return "";
+
+    unsigned char hash[KEY_CHECK_BYTES];
+    const std::string message = kKeyCheckMessage;
+    crypto_generichash(hash, sizeof hash, reinterpret_cast<const unsigned char *>(message.data()), message.size(),
+                       key, sizeof key);
+    return std::string(hash, hash + sizeof hash);
+}
+
+bool electronpass::Crypto::verify_key_check(const std::string& key_check_value) const {
+    const std::string expected = key_check();
+    if (expected.empty() || key_check_value.size() != expected.size()) return false;
+    return sodium_memcmp(expected.data(), key_check_value.data(), expected.size()) == 0;
+}
+
+std::string electronpass::Crypto::encrypt(const std::string& plain_text, bool& success) const {
+    if (!check()) {
+        success = false;
         return "";
     }
 
     // '/' is just a random char, which will be overwritten
     // At the begining of the string will be stored nonce and behind it encrypted message.
-    std::string cipher(nonce_size + cipher_text_len, '/');
+    std::string cipher(cipher_text_size(plain_text.length()), '/');
 
-    for (unsigned int i = 0; i < nonce_size; ++i) cipher[i] = nonce[i];
-    delete[] nonce;
-    for (unsigned long long i = 0; i < cipher_text_len; ++i) cipher[i + nonce_size] = cipher_text[i];
-    delete[] cipher_text;
+    success = encrypt(reinterpret_cast<const unsigned char *>(plain_text.data()), plain_text.length(),
+                      reinterpret_cast<unsigned char *>(&cipher[0]), cipher.length());
+    if (!success) return "";
 
     // encode everything in Base64 for better portabitity...
-    cipher = base64_encode(cipher);
-
-    return cipher;
+    return base64_encode(cipher);
 }
 
 std::string electronpass::Crypto::decrypt(const std::string& base64_cipher_text, bool& success) const {
@@ -105,52 +273,176 @@ std::string electronpass::Crypto::decrypt(const std::string& base64_cipher_text,
     // Convert from Base64.
     std::string cipher_text = base64_decode(base64_cipher_text);
 
-    // Get nonce from beginning of cipher_text.
-    unsigned int nonce_size = crypto_aead_chacha20poly1305_NPUBBYTES;  // 8 bytes
-    unsigned char *nonce = new unsigned char[nonce_size];
-
-    if (cipher_text.length() < nonce_size) {
+    if (cipher_text.length() < OVERHEAD_BYTES) {
         success = false;
         return "";
     }
-    
-    for (unsigned int i = 0; i < nonce_size; ++i) nonce[i] = cipher_text[i];
-
-    // Convert std::string to unsigned char array.
-    // New length will be smaller, because we won't copy first nonce_size bytes (8 bytes).
-    const unsigned int cipher_text_len = cipher_text.length() - nonce_size;
-    unsigned char *cipher = new unsigned char[cipher_text_len];
-
-    for (unsigned int i = 0; i < cipher_text_len; ++i) cipher[i] = cipher_text[i + nonce_size];
-    // delete string here, because it might be quite large and we are later allocating additional memory.
-    cipher_text.clear();
 
-    // Allocate memory.
-    unsigned char *plain_text = new unsigned char[cipher_text_len - crypto_aead_chacha20poly1305_ABYTES];
-    unsigned long long plain_text_len;
-
-    // Actual enctyption.
-    success = (crypto_aead_chacha20poly1305_decrypt(plain_text, &plain_text_len, NULL,
-                                                    cipher, cipher_text_len,
-                                                    NULL, 0, nonce, key) == 0);
-    delete[] cipher;
-    delete[] nonce;
+    // Decrypt in place, so we don't need to allocate memory for plain text.
+    // Plain text is written right behind the nonce.
+    unsigned char *cipher = reinterpret_cast<unsigned char *>(&cipher_text[0]);
+    const size_t plain_text_len = plain_text_size(cipher_text.length());
+    success = decrypt(cipher, cipher_text.length(), cipher + NONCE_BYTES, plain_text_len);
 
     if (!success) {
         // Probably authentication had failed.
         // Also possible that key was not generated or that sodium was not initialized.
-        delete[] plain_text;
         return "";
     }
 
-    // '/' is just a random char, which will be overwritten
-    // Need to copy in for loop because otherwise '\0' would terminate copying.
-    std::string plain(plain_text_len, '/');
+    cipher_text.resize(NONCE_BYTES + plain_text_len);
+    cipher_text.erase(0, NONCE_BYTES);
+    return cipher_text;
+}
+
+bool electronpass::Crypto::encrypt(const SecureString& plain_text, std::string& cipher_text) const {
+    cipher_text.clear();
+    if (!check()) return false;
+
+    std::string cipher(cipher_text_size(plain_text.length()), '/');
+    if (!encrypt(reinterpret_cast<const unsigned char *>(plain_text.data()), plain_text.length(),
+                 reinterpret_cast<unsigned char *>(&cipher[0]), cipher.length())) {
+        return false;
+    }
+    cipher_text = base64_encode(cipher);
+    return true;
+}
+
+bool electronpass::Crypto::decrypt(const std::string& base64_cipher_text, SecureString& plain_text) const {
+    wipe(plain_text);
+    if (!check()) return false;
+
+    // Only cipher text is decoded into ordinary memory, plain text is decrypted directly into secure memory.
+    const std::string cipher_text = base64_decode(base64_cipher_text);
+    if (cipher_text.length() < OVERHEAD_BYTES) return false;
+
+    plain_text.resize(plain_text_size(cipher_text.length()));
+    if (!decrypt(reinterpret_cast<const unsigned char *>(cipher_text.data()), cipher_text.length(),
+                 reinterpret_cast<unsigned char *>(&plain_text[0]), plain_text.length())) {
+        wipe(plain_text);
+        return false;
+    }
+    return true;
+}
+
+bool electronpass::Crypto::encrypt(const unsigned char *plain_text, size_t plain_text_len,
+                                   unsigned char *cipher_text, size_t cipher_text_len,
+                                   const unsigned char *additional_data, size_t additional_data_len,
+                                   Cipher cipher) const {
+    if (!check() || !cipher_available(cipher)) return false;
+    if (cipher_text_len != cipher_text_size(plain_text_len, cipher)) return false;
 
-    for (unsigned long long i = 0; i < plain_text_len; ++i) plain[i] = plain_text[i];
-    delete[] plain_text;
+    // Generate ranodom nonce. It will be added at the begining of encrypted data.
+    // (Same nonce should never be reused with same key, that's why we are generating a random one.)
+    const size_t nonce_len = nonce_size(cipher);
+    unsigned char *nonce = cipher_text;
+    Random::bytes(nonce, nonce_len);
+
+    return aead_encrypt(plain_text, plain_text_len, cipher_text + nonce_len, additional_data, additional_data_len,
+                        nonce, cipher);
+}
+
+bool electronpass::Crypto::decrypt(const unsigned char *cipher_text, size_t cipher_text_len,
+                                   unsigned char *plain_text, size_t plain_text_len,
+                                   const unsigned char *additional_data, size_t additional_data_len,
+                                   Cipher cipher) const {
+    if (!check() || !cipher_available(cipher)) return false;
+    if (cipher_text_len < cipher_text_size(0, cipher)) return false;
+    if (plain_text_len != plain_text_size(cipher_text_len, cipher)) return false;
+
+    // Nonce is stored at the beginning of cipher_text.
+    const size_t nonce_len = nonce_size(cipher);
+    return aead_decrypt(cipher_text + nonce_len, cipher_text_len - nonce_len, plain_text,
+                        additional_data, additional_data_len, cipher_text, cipher);
+}
+
+bool electronpass::Crypto::aead_encrypt(const unsigned char *plain_text, size_t plain_text_len,
+                                        unsigned char *encrypted,
+                                        const unsigned char *additional_data, size_t additional_data_len,
+                                        const unsigned char *nonce, Cipher cipher) const {
+    // Actual enctyption. Additional bytes are needed for authentication.
+    unsigned long long encrypted_len;
+    switch (cipher) {
+        case Cipher::CHACHA20_POLY1305:
+            return crypto_aead_chacha20poly1305_encrypt(encrypted, &encrypted_len, plain_text, plain_text_len,
+                                                        additional_data, additional_data_len, NULL, nonce, key) == 0;
+        case Cipher::XCHACHA20_POLY1305:
+            return crypto_aead_xchacha20poly1305_ietf_encrypt(encrypted, &encrypted_len, plain_text, plain_text_len,
+                                                              additional_data, additional_data_len,
+                                                              NULL, nonce, key) == 0;
+        case Cipher::AES256_GCM:
+            return crypto_aead_aes256gcm_encrypt(encrypted, &encrypted_len, plain_text, plain_text_len,
+                                                 additional_data, additional_data_len, NULL, nonce, key) == 0;
+    }
+    return false;
+}
+
+bool electronpass::Crypto::aead_decrypt(const unsigned char *encrypted, size_t encrypted_len,
+                                        unsigned char *plain_text,
+                                        const unsigned char *additional_data, size_t additional_data_len,
+                                        const unsigned char *nonce, Cipher cipher) const {
+    unsigned long long decrypted_len;
+    switch (cipher) {
+        case Cipher::CHACHA20_POLY1305:
+            return crypto_aead_chacha20poly1305_decrypt(plain_text, &decrypted_len, NULL, encrypted, encrypted_len,
+                                                        additional_data, additional_data_len, nonce, key) == 0;
+        case Cipher::XCHACHA20_POLY1305:
+            return crypto_aead_xchacha20poly1305_ietf_decrypt(plain_text, &decrypted_len, NULL,
+                                                              encrypted, encrypted_len,
+                                                              additional_data, additional_data_len, nonce, key) == 0;
+        case Cipher::AES256_GCM:
+            return crypto_aead_aes256gcm_decrypt(plain_text, &decrypted_len, NULL, encrypted, encrypted_len,
+                                                 additional_data, additional_data_len, nonce, key) == 0;
+    }
+    return false;
+}
+
+size_t electronpass::Crypto::nonce_size(Cipher cipher) {
+    switch (cipher) {
+        case Cipher::CHACHA20_POLY1305: return crypto_aead_chacha20poly1305_NPUBBYTES;  // 8 bytes
+        case Cipher::XCHACHA20_POLY1305: return crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;  // 24 bytes
+        case Cipher::AES256_GCM: return crypto_aead_aes256gcm_NPUBBYTES;  // 12 bytes
+    }
+    return 0;
+}
 
-    return plain;
+size_t electronpass::Crypto::cipher_text_size(size_t plain_text_len, Cipher cipher) {
+    // All algorithms use 16 bytes authentication tag.
+    return plain_text_len + nonce_size(cipher) + crypto_aead_chacha20poly1305_ABYTES;
+}
+
+size_t electronpass::Crypto::plain_text_size(size_t cipher_text_len, Cipher cipher) {
+    const size_t overhead = cipher_text_size(0, cipher);
+    if (cipher_text_len < overhead) return 0;
+    return cipher_text_len - overhead;
+}
+
+bool electronpass::Crypto::cipher_available(Cipher cipher) {
+    switch (cipher) {
+        case Cipher::CHACHA20_POLY1305:
+        case Cipher::XCHACHA20_POLY1305:
+            return true;
+        case Cipher::AES256_GCM: {
+            // CPU features are detected by sodium_init, so it has to be called first. Result doesn't change.
+            static const bool aes_available = sodium_init() != -1 && crypto_aead_aes256gcm_is_available() == 1;
+            return aes_available;
+        }
+    }
+    return false;
+}
+
+electronpass::Cipher electronpass::Crypto::preferred_cipher() {
+    return cipher_available(Cipher::AES256_GCM) ? Cipher::AES256_GCM : Cipher::XCHACHA20_POLY1305;
+}
+
+electronpass::Cipher electronpass::Crypto::cipher() const {
+    return wallet_cipher;
+}
+
+bool electronpass::Crypto::set_cipher(Cipher cipher) {
+    if (!cipher_available(cipher)) return false;
+    wallet_cipher = cipher;
+    return true;
 }
 
 bool electronpass::Crypto::check() const {
@@ -158,15 +450,8 @@ bool electronpass::Crypto::check() const {
 }
 
 std::string electronpass::Crypto::generate_uuid() {
-    assert(sodium_init() != -1);
-
     const unsigned int uuid_size = 24; // Bytes
-    unsigned char uuid[uuid_size];
-    randombytes_buf(uuid, uuid_size);
-
-    std::string uuid_str(uuid_size, '/');
-    for (unsigned long long i = 0; i < uuid_size; ++i) uuid_str[i] = uuid[i];
-    uuid_str = Crypto::base64_encode(uuid_str);
-
-    return uuid_str;
+    std::string uuid(uuid_size, '\0');
+    Random::bytes(&uuid[0], uuid_size);
+    return Crypto::base64_encode(uuid);
 }
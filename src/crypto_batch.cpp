@@ -0,0 +1,285 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crypto.hpp"
+#include "random.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+
+// Segment index, number of segments and last segment flag are appended to additional data of every segment.
+#define kSegmentInfoBytes 17
+
+const size_t electronpass::Crypto::SEGMENT_BYTES;
+
+namespace {
+    // Worker threads, that are shared by all batch and segmented operations. Threads are started when they are
+    // first needed and kept until the process exits, so calls don't pay for creating and joining threads.
+    class WorkerPool {
+        struct Job {
+            const std::function<void(size_t)> *work;
+            size_t count;
+            // Messages are usually small and of different sizes, so they are taken one by one instead of
+            // splitting them into equal ranges in advance.
+            std::atomic<size_t> next;
+            // Helpers, that are working on the job. Guarded by mutex.
+            size_t running;
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        // Every entry asks one worker to help with the job.
+        std::deque<Job *> queue;
+        size_t workers = 0;
+
+        static void work_on(Job& job) {
+            for (size_t i = job.next++; i < job.count; i = job.next++) (*job.work)(i);
+        }
+
+        void worker_loop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [this]() { return !queue.empty(); });
+                Job *job = queue.front();
+                queue.pop_front();
+                ++job->running;
+                lock.unlock();
+                work_on(*job);
+                lock.lock();
+                if (--job->running == 0) done.notify_all();
+            }
+        }
+
+        WorkerPool() {}
+
+      public:
+        // Pool is never destroyed: workers are idle between jobs, so exit doesn't have to wait for them, and
+        // a process forked from one with workers doesn't try to join threads, that it doesn't have.
+        static WorkerPool& instance() {
+            static WorkerPool *pool = new WorkerPool();
+            return *pool;
+        }
+
+        // Calls work(i) for every i in [0, count) on the calling thread and up to helpers worker threads.
+        void run(size_t count, size_t helpers, const std::function<void(size_t)>& work) {
+            Job job;
+            job.work = &work;
+            job.count = count;
+            job.next = 0;
+            job.running = 0;
+
+            if (helpers > 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (; workers < helpers; ++workers) std::thread(&WorkerPool::worker_loop, this).detach();
+                for (size_t i = 0; i < helpers; ++i) queue.push_back(&job);
+            }
+            if (helpers > 0) wake.notify_all();
+
+            work_on(job);
+            if (helpers == 0) return;
+
+            // Helpers, that haven't started yet, are not needed anymore. Waiting only for the running ones also
+            // means a job never waits for workers, that are busy with other jobs.
+            std::unique_lock<std::mutex> lock(mutex);
+            queue.erase(std::remove(queue.begin(), queue.end(), &job), queue.end());
+            done.wait(lock, [&job]() { return job.running == 0; });
+        }
+    };
+
+    // Calls work(i) for every i in [0, count), split between given number of threads. Calling thread is also
+    // used as one of the workers, others are taken from WorkerPool.
+    void run_parallel(size_t count, unsigned int threads, const std::function<void(size_t)>& work) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        if (threads > count) threads = static_cast<unsigned int>(count);
+        if (threads == 0) return;
+        WorkerPool::instance().run(count, threads - 1, work);
+    }
+
+    size_t segment_count(size_t plain_text_len) {
+        const size_t segment = electronpass::Crypto::SEGMENT_BYTES;
+        return plain_text_len == 0 ? 1 : (plain_text_len + segment - 1) / segment;
+    }
+
+    // Nonce of segment is the random nonce with little-endian segment index xored into its first bytes.
+    void segment_nonce(const unsigned char *nonce, size_t nonce_len, uint64_t index, unsigned char *out) {
+        std::copy(nonce, nonce + nonce_len, out);
+        for (size_t i = 0; i < 8 && i < nonce_len; ++i) out[i] ^= static_cast<unsigned char>(index >> (8 * i));
+    }
+
+    // Additional data of segment: user's additional data, followed by segment index, number of segments and
+    // last segment flag.
+    void segment_additional_data(const unsigned char *additional_data, size_t additional_data_len,
+                                 uint64_t index, uint64_t count, std::vector<unsigned char>& out) {
+        out.resize(additional_data_len + kSegmentInfoBytes);
+        if (additional_data_len > 0) std::copy(additional_data, additional_data + additional_data_len, out.begin());
+
+        unsigned char *info = out.data() + additional_data_len;
+        for (int i = 0; i < 8; ++i) {
+            info[i] = static_cast<unsigned char>(index >> (8 * i));
+            info[8 + i] = static_cast<unsigned char>(count >> (8 * i));
+        }
+        info[16] = index + 1 == count;
+    }
+}
+
+std::vector<std::string> electronpass::Crypto::encrypt_many(const std::vector<std::string>& plain_texts,
+                                                            bool& success, unsigned int threads) const {
+    if (!check()) {
+        success = false;
+        return std::vector<std::string>();
+    }
+
+    std::vector<std::string> cipher_texts(plain_texts.size());
+    std::atomic<bool> failed(false);
+    run_parallel(plain_texts.size(), threads, [&](size_t i) {
+        // Each thread reuses its own buffer for raw cipher text, so it only grows when a longer message comes.
+        thread_local std::string scratch;
+        scratch.resize(cipher_text_size(plain_texts[i].size()));
+
+        if (!encrypt(reinterpret_cast<const unsigned char *>(plain_texts[i].data()), plain_texts[i].size(),
+                     reinterpret_cast<unsigned char *>(&scratch[0]), scratch.size())) {
+            failed = true;
+            return;
+        }
+        cipher_texts[i] = base64_encode(scratch);
+    });
+
+    success = !failed;
+    if (!success) return std::vector<std::string>();
+    return cipher_texts;
+}
+
+electronpass::SecureStringVector electronpass::Crypto::decrypt_many(const std::vector<std::string>& cipher_texts,
+                                                                    std::vector<bool>& success,
+                                                                    unsigned int threads) const {
+    SecureStringVector plain_texts(cipher_texts.size());
+    // std::vector<bool> packs values into bits, so it can't be written from multiple threads.
+    std::vector<char> decrypted(cipher_texts.size(), 0);
+
+    if (check()) {
+        run_parallel(cipher_texts.size(), threads, [&](size_t i) {
+            // Each thread reuses its own buffer for raw cipher text, so it only grows when a longer message comes.
+            thread_local std::string scratch;
+            const std::string& base64 = cipher_texts[i];
+            scratch.resize(Base64Decoder::max_output_size(base64.size()));
+
+            Base64Decoder decoder;
+            size_t cipher_text_len = 0;
+            if (!decoder.update(base64.data(), base64.size(), reinterpret_cast<unsigned char *>(&scratch[0]),
+                                cipher_text_len) || !decoder.finish() || cipher_text_len < OVERHEAD_BYTES) {
+                return;
+            }
+
+            SecureString& plain_text = plain_texts[i];
+            plain_text.resize(plain_text_size(cipher_text_len));
+            if (decrypt(reinterpret_cast<const unsigned char *>(scratch.data()), cipher_text_len,
+                        reinterpret_cast<unsigned char *>(&plain_text[0]), plain_text.size())) {
+                decrypted[i] = 1;
+            } else {
+                plain_text.clear();
+            }
+        });
+    }
+
+    success.assign(decrypted.begin(), decrypted.end());
+    return plain_texts;
+}
+
+bool electronpass::Crypto::encrypt_segmented(const unsigned char *plain_text, size_t plain_text_len,
+                                             unsigned char *cipher_text, size_t cipher_text_len,
+                                             const unsigned char *additional_data, size_t additional_data_len,
+                                             Cipher cipher, unsigned int threads) const {
+    if (!check() || !cipher_available(cipher)) return false;
+    if (cipher_text_len != segmented_cipher_text_size(plain_text_len, cipher)) return false;
+
+    const size_t nonce_len = nonce_size(cipher);
+    const size_t tag_len = cipher_text_size(0, cipher) - nonce_len;
+    const size_t count = segment_count(plain_text_len);
+    Random::bytes(cipher_text, nonce_len);
+
+    std::atomic<bool> failed(false);
+    run_parallel(count, threads, [&](size_t i) {
+        const size_t offset = i * SEGMENT_BYTES;
+        const size_t length = std::min(SEGMENT_BYTES, plain_text_len - offset);
+
+        unsigned char nonce[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES];
+        segment_nonce(cipher_text, nonce_len, i, nonce);
+        std::vector<unsigned char> ad;
+        segment_additional_data(additional_data, additional_data_len, i, count, ad);
+
+        unsigned char *encrypted = cipher_text + nonce_len + i * (SEGMENT_BYTES + tag_len);
+        if (!aead_encrypt(plain_text + offset, length, encrypted, ad.data(), ad.size(), nonce, cipher)) failed = true;
+    });
+
+    return !failed;
+}
+
+bool electronpass::Crypto::decrypt_segmented(const unsigned char *cipher_text, size_t cipher_text_len,
+                                             unsigned char *plain_text, size_t plain_text_len,
+                                             const unsigned char *additional_data, size_t additional_data_len,
+                                             Cipher cipher, unsigned int threads) const {
+    if (!check() || !cipher_available(cipher)) return false;
+    // Checks both lengths, because some cipher text lengths can't be produced by encrypt_segmented().
+    if (cipher_text_len != segmented_cipher_text_size(plain_text_len, cipher)) return false;
+
+    const size_t nonce_len = nonce_size(cipher);
+    const size_t tag_len = cipher_text_size(0, cipher) - nonce_len;
+    const size_t count = segment_count(plain_text_len);
+
+    std::atomic<bool> failed(false);
+    run_parallel(count, threads, [&](size_t i) {
+        if (failed) return;
+        const size_t offset = i * SEGMENT_BYTES;
+        const size_t length = std::min(SEGMENT_BYTES, plain_text_len - offset);
+
+        unsigned char nonce[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES];
+        segment_nonce(cipher_text, nonce_len, i, nonce);
+        std::vector<unsigned char> ad;
+        segment_additional_data(additional_data, additional_data_len, i, count, ad);
+
+        const unsigned char *encrypted = cipher_text + nonce_len + i * (SEGMENT_BYTES + tag_len);
+        if (!aead_decrypt(encrypted, length + tag_len, plain_text + offset, ad.data(), ad.size(), nonce, cipher)) {
+            failed = true;
+        }
+    });
+
+    // Segments, that were authenticated, must not be used if any other segment failed.
+    if (failed) sodium_memzero(plain_text, plain_text_len);
+    return !failed;
+}
+
+size_t electronpass::Crypto::segmented_cipher_text_size(size_t plain_text_len, Cipher cipher) {
+    const size_t tag_len = cipher_text_size(0, cipher) - nonce_size(cipher);
+    return nonce_size(cipher) + plain_text_len + segment_count(plain_text_len) * tag_len;
+}
+
+size_t electronpass::Crypto::segmented_plain_text_size(size_t cipher_text_len, Cipher cipher) {
+    const size_t nonce_len = nonce_size(cipher);
+    const size_t tag_len = cipher_text_size(0, cipher) - nonce_len;
+    if (cipher_text_len < nonce_len + tag_len) return 0;
+
+    // All segments except the last one are full.
+    const size_t body = cipher_text_len - nonce_len;
+    const size_t full_segments = body / (SEGMENT_BYTES + tag_len);
+    const size_t rest = body % (SEGMENT_BYTES + tag_len);
+    if (rest == 0) return full_segments * SEGMENT_BYTES;
+    if (rest < tag_len) return 0;
+    return full_segments * SEGMENT_BYTES + rest - tag_len;
+}
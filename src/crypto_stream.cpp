@@ -0,0 +1,218 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crypto.hpp"
+#include "secure_memory.hpp"
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+const size_t electronpass::Crypto::STREAM_CHUNK_BYTES;
+const size_t electronpass::IncrementalDecryptor::BLOCK_BYTES;
+const size_t electronpass::IncrementalDecryptor::TAG_BYTES;
+
+// Reads up to len bytes from stream and returns number of bytes read.
+static size_t read_chunk(std::istream& in, unsigned char *buffer, size_t len) {
+    in.read(reinterpret_cast<char *>(buffer), len);
+    return static_cast<size_t>(in.gcount());
+}
+
+static bool at_end(std::istream& in) {
+    return in.peek() == std::istream::traits_type::eof();
+}
+
+bool electronpass::Crypto::encrypt_stream(std::istream& in, std::ostream& out,
+                                          const std::string& additional_data) const {
+    if (!check()) return false;
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    unsigned char header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    crypto_secretstream_xchacha20poly1305_init_push(&state, header, key);
+    out.write(reinterpret_cast<const char *>(header), sizeof header);
+
+    // Plain text buffer is wiped by SecureArena when it is freed.
+    SecureBuffer plain(STREAM_CHUNK_BYTES);
+    std::vector<unsigned char> cipher(STREAM_CHUNK_BYTES + crypto_secretstream_xchacha20poly1305_ABYTES);
+
+    // Additional data is authenticated with the first chunk. Following chunks depend on it through the stream state.
+    const unsigned char *ad = reinterpret_cast<const unsigned char *>(additional_data.data());
+    unsigned long long ad_len = additional_data.length();
+
+    bool last = false;
+    while (!last) {
+        size_t plain_len = read_chunk(in, plain.data(), plain.size());
+        if (in.bad()) break;
+
+        // Last chunk can also be empty, when input size is a multiple of chunk size.
+        last = plain_len < plain.size() || at_end(in);
+        unsigned char tag = last ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0;
+
+        unsigned long long cipher_len;
+        crypto_secretstream_xchacha20poly1305_push(&state, cipher.data(), &cipher_len, plain.data(), plain_len,
+                                                   ad, ad_len, tag);
+        out.write(reinterpret_cast<const char *>(cipher.data()), cipher_len);
+        ad = NULL;
+        ad_len = 0;
+    }
+
+    sodium_memzero(&state, sizeof state);
+
+    return last && out.good();
+}
+
+bool electronpass::Crypto::decrypt_stream(std::istream& in, std::ostream& out,
+                                          const std::string& additional_data) const {
+    if (!check()) return false;
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    unsigned char header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    if (read_chunk(in, header, sizeof header) != sizeof header) return false;
+    if (crypto_secretstream_xchacha20poly1305_init_pull(&state, header, key) != 0) return false;
+
+    std::vector<unsigned char> cipher(STREAM_CHUNK_BYTES + crypto_secretstream_xchacha20poly1305_ABYTES);
+    SecureBuffer plain(STREAM_CHUNK_BYTES);
+
+    const unsigned char *ad = reinterpret_cast<const unsigned char *>(additional_data.data());
+    unsigned long long ad_len = additional_data.length();
+
+    bool success = false;
+    while (true) {
+        size_t cipher_len = read_chunk(in, cipher.data(), cipher.size());
+
+        unsigned long long plain_len;
+        unsigned char tag;
+        if (crypto_secretstream_xchacha20poly1305_pull(&state, plain.data(), &plain_len, &tag,
+                                                       cipher.data(), cipher_len, ad, ad_len) != 0) {
+            // Corrupted chunk or truncated stream.
+            break;
+        }
+        ad = NULL;
+        ad_len = 0;
+        out.write(reinterpret_cast<const char *>(plain.data()), plain_len);
+
+        if (tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL) {
+            // There must be no data behind the final chunk.
+            success = at_end(in);
+            break;
+        }
+        // Only the final chunk can be shorter than STREAM_CHUNK_BYTES.
+        if (cipher_len < cipher.size()) break;
+    }
+
+    sodium_memzero(&state, sizeof state);
+
+    return success && out.good();
+}
+
+electronpass::IncrementalDecryptor::IncrementalDecryptor(const Crypto& crypto): failed{!crypto.check()} {
+    std::memcpy(key, crypto.key, sizeof key);
+}
+
+electronpass::IncrementalDecryptor::~IncrementalDecryptor() {
+    sodium_memzero(key, sizeof key);
+    sodium_memzero(&mac, sizeof mac);
+    sodium_memzero(pending, sizeof pending);
+}
+
+void electronpass::IncrementalDecryptor::decrypt(const unsigned char *cipher_text, size_t len,
+                                                 SecureBuffer& plain_text) {
+    // Same construction as crypto_aead_chacha20poly1305_decrypt(): cipher text is authenticated and then decrypted
+    // with key stream starting at block 1. Everything except the last call is a multiple of the block size.
+    crypto_onetimeauth_poly1305_update(&mac, cipher_text, len);
+
+    const size_t offset = plain_text.size();
+    plain_text.resize(offset + len);
+    crypto_stream_chacha20_xor_ic(plain_text.data() + offset, cipher_text, len, nonce,
+                                  1 + decrypted_len / BLOCK_BYTES, key);
+    decrypted_len += len;
+}
+
+bool electronpass::IncrementalDecryptor::update(const unsigned char *cipher_text, size_t len,
+                                                SecureBuffer& plain_text) {
+    if (failed) return false;
+
+    // Nonce is at the beginning of cipher text.
+    if (nonce_len < sizeof nonce) {
+        const size_t n = std::min(len, sizeof nonce - nonce_len);
+        std::memcpy(nonce + nonce_len, cipher_text, n);
+        nonce_len += n;
+        cipher_text += n;
+        len -= n;
+        if (nonce_len < sizeof nonce) return true;
+
+        // Poly1305 key is the first part of block 0. Additional data is empty, so only its length is authenticated.
+        unsigned char block0[BLOCK_BYTES];
+        crypto_stream_chacha20(block0, sizeof block0, nonce, key);
+        crypto_onetimeauth_poly1305_init(&mac, block0);
+        sodium_memzero(block0, sizeof block0);
+
+        unsigned char ad_len[8] = {0};
+        crypto_onetimeauth_poly1305_update(&mac, ad_len, sizeof ad_len);
+    }
+
+    while (len > 0) {
+        if (pending_len + len < sizeof pending) {
+            // Not enough data to know, that a whole block is not a part of the tag.
+            std::memcpy(pending + pending_len, cipher_text, len);
+            pending_len += len;
+            break;
+        }
+
+        if (pending_len > 0) {
+            // Complete a block from pending data.
+            if (pending_len < BLOCK_BYTES) {
+                const size_t n = BLOCK_BYTES - pending_len;
+                std::memcpy(pending + pending_len, cipher_text, n);
+                pending_len = BLOCK_BYTES;
+                cipher_text += n;
+                len -= n;
+            }
+            decrypt(pending, BLOCK_BYTES, plain_text);
+            pending_len -= BLOCK_BYTES;
+            std::memmove(pending, pending + BLOCK_BYTES, pending_len);
+            continue;
+        }
+
+        // Whole blocks are decrypted directly from input.
+        const size_t n = (len - TAG_BYTES) / BLOCK_BYTES * BLOCK_BYTES;
+        decrypt(cipher_text, n, plain_text);
+        cipher_text += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool electronpass::IncrementalDecryptor::finish(SecureBuffer& plain_text) {
+    if (failed || nonce_len < sizeof nonce || pending_len < TAG_BYTES) {
+        failed = true;
+        return false;
+    }
+    failed = true;
+
+    decrypt(pending, pending_len - TAG_BYTES, plain_text);
+
+    unsigned char message_len[8];
+    for (size_t i = 0; i < sizeof message_len; ++i) {
+        message_len[i] = static_cast<unsigned char>((decrypted_len >> (8 * i)) & 0xff);
+    }
+    crypto_onetimeauth_poly1305_update(&mac, message_len, sizeof message_len);
+
+    unsigned char tag[TAG_BYTES];
+    crypto_onetimeauth_poly1305_final(&mac, tag);
+    return crypto_verify_16(tag, pending + pending_len - TAG_BYTES) == 0;
+}
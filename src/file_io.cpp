@@ -0,0 +1,168 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "file_io.hpp"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Suffix of temporary file, that is renamed over the wallet. X's are replaced with random characters.
+#define kTempSuffix ".tmp-XXXXXX"
+
+// Buffer grows by this much, if file is longer than it was when it was opened.
+#define kReadChunkBytes 4096
+
+// Largest single write on Windows.
+#define kMaxWriteBytes (static_cast<size_t>(1) << 30)
+
+#ifdef _WIN32
+
+bool electronpass::file_io::read_file(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+namespace {
+    std::string directory_of(const std::string& path) {
+        const size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    }
+}
+
+bool electronpass::file_io::write_atomic(const std::string& path, const char *data, size_t len) {
+    // GetTempFileName() creates a new file with a unique name in the same directory, so it can be renamed and
+    // concurrent saves don't share a temporary file.
+    char temp_path[MAX_PATH];
+    if (GetTempFileNameA(directory_of(path).c_str(), "ep", 0, temp_path) == 0) return false;
+
+    HANDLE file = CreateFileA(temp_path, GENERIC_WRITE, 0, NULL, TRUNCATE_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        DeleteFileA(temp_path);
+        return false;
+    }
+
+    // Data must be on disk before rename, otherwise a crash could leave renamed, but empty file.
+    bool success = true;
+    while (success && len > 0) {
+        // WriteFile() takes 32-bit length. windows.h defines min() macro, so std::min can't be used here.
+        const DWORD chunk = static_cast<DWORD>(len < kMaxWriteBytes ? len : kMaxWriteBytes);
+        DWORD written = 0;
+        success = WriteFile(file, data, chunk, &written, NULL) != 0;
+        data += written;
+        len -= written;
+    }
+    success = success && FlushFileBuffers(file) != 0;
+    success = CloseHandle(file) != 0 && success;
+
+    if (!success || !MoveFileExA(temp_path, path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileA(temp_path);
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool electronpass::file_io::read_file(const std::string& path, std::string& data) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    // Wallet is read from start to end once. Size is only a hint, file is read until its end, even if it has
+    // changed in the meantime.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    data.resize(static_cast<size_t>(info.st_size));
+    size_t size = 0;
+    while (true) {
+        if (size == data.size()) data.resize(data.size() + kReadChunkBytes);
+        const ssize_t count = read(fd, &data[size], data.size() - size);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        if (count == 0) break;
+        size += static_cast<size_t>(count);
+    }
+    data.resize(size);
+    close(fd);
+    return true;
+}
+
+namespace {
+    bool write_all(int fd, const char *data, size_t len) {
+        while (len > 0) {
+            const ssize_t written = write(fd, data, len);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            len -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // Flushes directory, so rename is on disk too. Some file systems can't sync directories, so failure is ignored.
+    void sync_directory(const std::string& path) {
+        const size_t slash = path.find_last_of('/');
+        const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        const int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        fsync(fd);
+        close(fd);
+    }
+}
+
+bool electronpass::file_io::write_atomic(const std::string& path, const char *data, size_t len) {
+    // Temporary file is in the same directory, so it can be renamed. mkstemp() creates it only readable and writable
+    // by the owner.
+    std::string temp_path = path + kTempSuffix;
+    const int fd = mkstemp(&temp_path[0]);
+    if (fd < 0) return false;
+
+    // Data is written with one write, if possible. It must be on disk before rename, otherwise a crash could leave
+    // renamed, but empty file.
+    bool success = write_all(fd, data, len) && fsync(fd) == 0;
+    success = close(fd) == 0 && success;
+    if (!success || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    sync_directory(path);
+    return true;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELECTRONPASS_FILE_IO_HPP
+#define ELECTRONPASS_FILE_IO_HPP
+
+#include <string>
+
+// Internal file access of serialization::load_file() and serialization::save_file().
+
+namespace electronpass {
+    namespace file_io {
+        // Reads whole file into data, with a single allocation of the file size. File is not mapped into memory:
+        // a mapping would crash the process if the file was truncated while it is read, and bytes could change
+        // between authentication and decryption. Returns false if file can't be opened or read.
+        bool read_file(const std::string& path, std::string& data);
+
+        // Writes data into a new temporary file in the same directory as path, flushes it to disk and renames it
+        // over path. If anything fails, temporary file is removed and path is not changed.
+        bool write_atomic(const std::string& path, const char *data, size_t len);
+    }
+}
+
+#endif // ELECTRONPASS_FILE_IO_HPP
@@ -0,0 +1,178 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "wallet.hpp"
+#include "random.hpp"
+#include <cstring>
+
+// Longest Base64, that decodes into at most ItemId::MAX_BYTES bytes.
+#define kMaxBase64Chars 32
+
+const size_t electronpass::ItemId::MAX_BYTES;
+
+electronpass::ItemId::ItemId(): length{0}, kind{Kind::TEXT} {}
+
+electronpass::ItemId::ItemId(const std::string& id): ItemId() {
+    assign(id.data(), id.size());
+}
+
+electronpass::ItemId::ItemId(const char *id): ItemId() {
+    assign(id, std::strlen(id));
+}
+
+electronpass::ItemId::ItemId(const char *id, size_t len): ItemId() {
+    assign(id, len);
+}
+
+electronpass::ItemId::ItemId(const ItemId& other): ItemId() {
+    *this = other;
+}
+
+electronpass::ItemId::ItemId(ItemId&& other) noexcept: ItemId() {
+    *this = std::move(other);
+}
+
+electronpass::ItemId& electronpass::ItemId::operator=(const ItemId& other) {
+    if (this == &other) return *this;
+    release();
+    if (other.kind == Kind::TEXT && other.length > MAX_BYTES) {
+        heap = new char[other.length];
+        std::memcpy(heap, other.heap, other.length);
+    } else {
+        std::memcpy(bytes, other.bytes, sizeof bytes);
+    }
+    length = other.length;
+    kind = other.kind;
+    return *this;
+}
+
+electronpass::ItemId& electronpass::ItemId::operator=(ItemId&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    std::memcpy(bytes, other.bytes, sizeof bytes);
+    length = other.length;
+    kind = other.kind;
+    // Heap text now belongs to this id.
+    other.length = 0;
+    other.kind = Kind::TEXT;
+    return *this;
+}
+
+electronpass::ItemId::~ItemId() {
+    release();
+}
+
+void electronpass::ItemId::release() {
+    if (kind == Kind::TEXT && length > MAX_BYTES) delete[] heap;
+    length = 0;
+    kind = Kind::TEXT;
+}
+
+const unsigned char *electronpass::ItemId::data() const {
+    if (kind == Kind::TEXT && length > MAX_BYTES) return reinterpret_cast<const unsigned char *>(heap);
+    return bytes;
+}
+
+void electronpass::ItemId::assign(const char *id, size_t len) {
+    // Only canonical Base64 is stored as bytes, so converting it back gives the same string.
+    if (len > 0 && len <= kMaxBase64Chars && len % 4 == 0) {
+        unsigned char decoded[kMaxBase64Chars];
+        Base64Decoder decoder;
+        size_t decoded_len = 0;
+        if (decoder.update(id, len, decoded, decoded_len) && decoder.finish() && decoded_len > 0) {
+            std::memcpy(bytes, decoded, decoded_len);
+            length = static_cast<uint32_t>(decoded_len);
+            kind = Kind::BINARY;
+            return;
+        }
+    }
+
+    kind = Kind::TEXT;
+    length = static_cast<uint32_t>(len);
+    if (len > MAX_BYTES) {
+        heap = new char[len];
+        std::memcpy(heap, id, len);
+    } else {
+        std::memcpy(bytes, id, len);
+    }
+}
+
+electronpass::ItemId electronpass::ItemId::generate() {
+    ItemId id;
+    Random::bytes(id.bytes, MAX_BYTES);
+    id.length = MAX_BYTES;
+    id.kind = Kind::BINARY;
+    return id;
+}
+
+electronpass::ItemId electronpass::ItemId::from_bytes(const unsigned char *bytes, size_t len) {
+    ItemId id;
+    if (len == 0 || len > MAX_BYTES) return id;
+    std::memcpy(id.bytes, bytes, len);
+    id.length = static_cast<uint32_t>(len);
+    id.kind = Kind::BINARY;
+    return id;
+}
+
+std::string electronpass::ItemId::to_string() const {
+    if (kind == Kind::TEXT) return std::string(reinterpret_cast<const char *>(data()), length);
+
+    char encoded[kMaxBase64Chars + Base64Encoder::FINISH_BYTES];
+    Base64Encoder encoder;
+    size_t encoded_len = encoder.update(bytes, length, encoded);
+    encoded_len += encoder.finish(encoded + encoded_len);
+    return std::string(encoded, encoded_len);
+}
+
+bool electronpass::ItemId::empty() const {
+    return length == 0;
+}
+
+bool electronpass::ItemId::binary() const {
+    return kind == Kind::BINARY;
+}
+
+size_t electronpass::ItemId::size() const {
+    return length;
+}
+
+size_t electronpass::ItemId::hash() const {
+    const unsigned char *id = data();
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length ^ (static_cast<uint64_t>(kind) << 32);
+    for (size_t i = 0; i < length; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, id + i, length - i < 8 ? length - i : 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    return static_cast<size_t>(hash);
+}
+
+bool electronpass::operator==(const ItemId& a, const ItemId& b) {
+    return a.kind == b.kind && a.length == b.length && std::memcmp(a.data(), b.data(), a.length) == 0;
+}
+
+bool electronpass::operator!=(const ItemId& a, const ItemId& b) {
+    return !(a == b);
+}
+
+bool electronpass::operator<(const ItemId& a, const ItemId& b) {
+    if (a.kind != b.kind) return a.kind < b.kind;
+    const int compare = std::memcmp(a.data(), b.data(), a.length < b.length ? a.length : b.length);
+    return compare != 0 ? compare < 0 : a.length < b.length;
+}
@@ -0,0 +1,318 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "json_parser.hpp"
+
+// Longest number or literal (true, false, null). Longer tokens are invalid.
+#define kMaxTokenBytes 64
+// Longest key. Keys of wallet JSON are item ids and short names.
+#define kMaxKeyBytes 4096
+
+namespace {
+    bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool is_whitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Checks JSON number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool valid_number(const std::string& number) {
+        size_t i = 0;
+        const size_t n = number.size();
+        if (i < n && number[i] == '-') ++i;
+        if (i >= n || !is_digit(number[i])) return false;
+        if (number[i++] != '0') {
+            while (i < n && is_digit(number[i])) ++i;
+        }
+        if (i < n && number[i] == '.') {
+            if (++i >= n || !is_digit(number[i])) return false;
+            while (i < n && is_digit(number[i])) ++i;
+        }
+        if (i < n && (number[i] == 'e' || number[i] == 'E')) {
+            ++i;
+            if (i < n && (number[i] == '+' || number[i] == '-')) ++i;
+            if (i >= n || !is_digit(number[i])) return false;
+            while (i < n && is_digit(number[i])) ++i;
+        }
+        return i == n;
+    }
+}
+
+electronpass::JsonParser::JsonParser(JsonHandler& handler_): handler(handler_), state{State::VALUE}, in_key{false},
+                                                             code_unit{0}, hex_digits{0}, high_surrogate{0} {}
+
+bool electronpass::JsonParser::fail() {
+    state = State::FAILED;
+    return false;
+}
+
+bool electronpass::JsonParser::value_done() {
+    state = stack.empty() ? State::DONE : State::COMMA_OR_END;
+    return true;
+}
+
+bool electronpass::JsonParser::start_value(char c) {
+    switch (c) {
+        case '{':
+            stack.push_back('{');
+            state = State::FIRST_KEY_OR_END;
+            return handler.start_object();
+        case '[':
+            stack.push_back('[');
+            state = State::FIRST_VALUE_OR_END;
+            return handler.start_array();
+        case '"':
+            in_key = false;
+            state = State::STRING;
+            return true;
+        case 't':
+        case 'f':
+        case 'n':
+            buffer.assign(1, c);
+            state = State::LITERAL;
+            return true;
+        default:
+            if (c != '-' && !is_digit(c)) return false;
+            buffer.assign(1, c);
+            state = State::NUMBER;
+            return true;
+    }
+}
+
+bool electronpass::JsonParser::end_container(char c) {
+    const char open = c == '}' ? '{' : '[';
+    if (stack.empty() || stack.back() != open) return false;
+    stack.pop_back();
+    if (!(open == '{' ? handler.end_object() : handler.end_array())) return false;
+    return value_done();
+}
+
+bool electronpass::JsonParser::finish_token() {
+    if (state == State::NUMBER) {
+        if (!valid_number(buffer) || !handler.number(buffer)) return false;
+    } else if (buffer == "true" || buffer == "false") {
+        if (!handler.boolean(buffer == "true")) return false;
+    } else if (buffer == "null") {
+        if (!handler.null()) return false;
+    } else {
+        return false;
+    }
+    return value_done();
+}
+
+bool electronpass::JsonParser::append_string(const char *s, size_t len) {
+    if (in_key) {
+        if (buffer.size() + len > kMaxKeyBytes) return false;
+        buffer.append(s, len);
+        return true;
+    }
+    return handler.string_part(s, len);
+}
+
+bool electronpass::JsonParser::append_code_point(unsigned int code_point) {
+    char utf8[4];
+    size_t len;
+    if (code_point < 0x80) {
+        utf8[0] = static_cast<char>(code_point);
+        len = 1;
+    } else if (code_point < 0x800) {
+        utf8[0] = static_cast<char>(0xc0 | (code_point >> 6));
+        utf8[1] = static_cast<char>(0x80 | (code_point & 0x3f));
+        len = 2;
+    } else if (code_point < 0x10000) {
+        utf8[0] = static_cast<char>(0xe0 | (code_point >> 12));
+        utf8[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+        utf8[2] = static_cast<char>(0x80 | (code_point & 0x3f));
+        len = 3;
+    } else {
+        utf8[0] = static_cast<char>(0xf0 | (code_point >> 18));
+        utf8[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+        utf8[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+        utf8[3] = static_cast<char>(0x80 | (code_point & 0x3f));
+        len = 4;
+    }
+    return append_string(utf8, len);
+}
+
+bool electronpass::JsonParser::feed(const char *data, size_t len) {
+    if (state == State::FAILED) return false;
+
+    size_t i = 0;
+    while (i < len) {
+        const char c = data[i];
+
+        switch (state) {
+            case State::STRING: {
+                // Characters without escapes are passed on in one part.
+                size_t j = i;
+                while (j < len && data[j] != '"' && data[j] != '\\' && static_cast<unsigned char>(data[j]) >= 0x20) {
+                    ++j;
+                }
+                if (j > i) {
+                    if (high_surrogate != 0 || !append_string(data + i, j - i)) return fail();
+                    i = j;
+                } else if (c == '"') {
+                    ++i;
+                    if (high_surrogate != 0) return fail();
+                    if (in_key) {
+                        if (!handler.key(buffer)) return fail();
+                        state = State::COLON;
+                    } else {
+                        if (!handler.string_end()) return fail();
+                        value_done();
+                    }
+                } else if (c == '\\') {
+                    ++i;
+                    state = State::ESCAPE;
+                } else {
+                    // Control characters must be escaped.
+                    return fail();
+                }
+                continue;
+            }
+
+            case State::ESCAPE: {
+                ++i;
+                if (c == 'u') {
+                    code_unit = 0;
+                    hex_digits = 0;
+                    state = State::UNICODE;
+                    continue;
+                }
+                if (high_surrogate != 0) return fail();
+
+                char unescaped;
+                switch (c) {
+                    case '"': unescaped = '"'; break;
+                    case '\\': unescaped = '\\'; break;
+                    case '/': unescaped = '/'; break;
+                    case 'b': unescaped = '\b'; break;
+                    case 'f': unescaped = '\f'; break;
+                    case 'n': unescaped = '\n'; break;
+                    case 'r': unescaped = '\r'; break;
+                    case 't': unescaped = '\t'; break;
+                    default: return fail();
+                }
+                if (!append_string(&unescaped, 1)) return fail();
+                state = State::STRING;
+                continue;
+            }
+
+            case State::UNICODE: {
+                ++i;
+                const int digit = hex_value(c);
+                if (digit < 0) return fail();
+                code_unit = code_unit * 16 + static_cast<unsigned int>(digit);
+                if (++hex_digits < 4) continue;
+
+                state = State::STRING;
+                bool success;
+                if (high_surrogate != 0) {
+                    // Surrogate pair.
+                    if (code_unit < 0xdc00 || code_unit > 0xdfff) return fail();
+                    success = append_code_point(0x10000 + ((high_surrogate - 0xd800) << 10) + (code_unit - 0xdc00));
+                    high_surrogate = 0;
+                } else if (code_unit >= 0xd800 && code_unit <= 0xdbff) {
+                    high_surrogate = code_unit;
+                    success = true;
+                } else {
+                    success = code_unit < 0xdc00 || code_unit > 0xdfff ? append_code_point(code_unit) : false;
+                }
+                if (!success) return fail();
+                continue;
+            }
+
+            case State::NUMBER:
+            case State::LITERAL: {
+                const bool token_char = state == State::NUMBER
+                                        ? is_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'
+                                        : c >= 'a' && c <= 'z';
+                if (token_char) {
+                    if (buffer.size() == kMaxTokenBytes) return fail();
+                    buffer += c;
+                    ++i;
+                } else if (!finish_token()) {
+                    return fail();
+                }
+                // Character after the token is processed in the new state.
+                continue;
+            }
+
+            default:
+                break;
+        }
+
+        ++i;
+        if (is_whitespace(c)) continue;
+
+        bool success;
+        switch (state) {
+            case State::VALUE:
+                success = start_value(c);
+                break;
+            case State::FIRST_VALUE_OR_END:
+                success = c == ']' ? end_container(c) : start_value(c);
+                break;
+            case State::FIRST_KEY_OR_END:
+            case State::KEY:
+                if (c == '}' && state == State::FIRST_KEY_OR_END) {
+                    success = end_container(c);
+                } else {
+                    success = c == '"';
+                    in_key = true;
+                    buffer.clear();
+                    state = State::STRING;
+                }
+                break;
+            case State::COLON:
+                success = c == ':';
+                state = State::VALUE;
+                break;
+            case State::COMMA_OR_END:
+                if (c == ',') {
+                    success = true;
+                    state = stack.back() == '{' ? State::KEY : State::VALUE;
+                } else {
+                    success = (c == '}' || c == ']') && end_container(c);
+                }
+                break;
+            default:
+                // Only whitespace is allowed after the value.
+                success = false;
+                break;
+        }
+        if (!success) return fail();
+    }
+
+    return true;
+}
+
+bool electronpass::JsonParser::finish() {
+    // Number or literal at the end of input is only complete now.
+    if ((state == State::NUMBER || state == State::LITERAL) && !finish_token()) return fail();
+    return state == State::DONE;
+}
@@ -0,0 +1,88 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELECTRONPASS_JSON_PARSER_HPP
+#define ELECTRONPASS_JSON_PARSER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Internal incremental JSON parser. It is not installed with the public headers.
+
+namespace electronpass {
+    // Receives events from JsonParser. Returning false from any function stops parsing with an error.
+    class JsonHandler {
+      public:
+        virtual ~JsonHandler() {}
+
+        virtual bool start_object() = 0;
+        virtual bool end_object() = 0;
+        virtual bool start_array() = 0;
+        virtual bool end_array() = 0;
+        // Key of the next value in an object. Keys are passed whole.
+        virtual bool key(const std::string& key) = 0;
+        // String values are passed in parts (already unescaped), so long strings don't have to be held in memory.
+        // string_part() can be called zero or more times and is always followed by string_end().
+        virtual bool string_part(const char *s, size_t len) = 0;
+        virtual bool string_end() = 0;
+        // Number as it was written in JSON.
+        virtual bool number(const std::string& number) = 0;
+        virtual bool boolean(bool value) = 0;
+        virtual bool null() = 0;
+    };
+
+    // Push parser, which accepts JSON in chunks of any size and reports it to a JsonHandler. Only keys, numbers and
+    // literals are buffered, and their length is limited, so memory doesn't grow with the input.
+    class JsonParser {
+        enum class State {
+            VALUE, FIRST_VALUE_OR_END, FIRST_KEY_OR_END, KEY, COLON, COMMA_OR_END,
+            STRING, ESCAPE, UNICODE, NUMBER, LITERAL, DONE, FAILED
+        };
+
+        JsonHandler& handler;
+        State state;
+        // Open objects ('{') and arrays ('[').
+        std::vector<char> stack;
+        // If current string is a key, it is collected here.
+        bool in_key;
+        std::string buffer;
+        // Code unit of \uXXXX escape, that is being read, and high surrogate, waiting for its pair.
+        unsigned int code_unit;
+        int hex_digits;
+        unsigned int high_surrogate;
+
+        bool fail();
+        bool value_done();
+        bool start_value(char c);
+        bool end_container(char c);
+        bool finish_token();
+        bool append_string(const char *s, size_t len);
+        bool append_code_point(unsigned int code_point);
+
+      public:
+        JsonParser(JsonHandler& handler_);
+
+        // Parses next chunk of JSON. Returns false if JSON is invalid or handler stopped parsing.
+        bool feed(const char *data, size_t len);
+
+        // Checks that JSON was complete. Returns false if it wasn't or if it was invalid.
+        bool finish();
+    };
+}
+
+#endif // ELECTRONPASS_JSON_PARSER_HPP
@@ -0,0 +1,156 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crypto.hpp"
+#include <chrono>
+#include <algorithm>
+
+// Upper bound for Argon2id opslimit of wallets being opened. It is much higher than the SENSITIVE profile, so
+// calibrated parameters fit, but still stops wallets from making key derivation run for hours.
+#define kArgon2idMaxOpslimit 256
+
+electronpass::KdfParams electronpass::KdfParams::legacy() {
+    KdfParams params;
+    params.algorithm = Algorithm::SCRYPT;
+    params.opslimit = crypto_pwhash_scryptsalsa208sha256_OPSLIMIT_INTERACTIVE;
+    params.memlimit = crypto_pwhash_scryptsalsa208sha256_MEMLIMIT_INTERACTIVE;
+    params.salt = std::string(CRYPTO_SALT, CRYPTO_SALT + sizeof CRYPTO_SALT);
+    return params;
+}
+
+electronpass::KdfParams electronpass::KdfParams::generate(Profile profile) {
+    KdfParams params;
+    params.algorithm = Algorithm::ARGON2ID;
+
+    switch (profile) {
+        case Profile::INTERACTIVE:
+            params.opslimit = crypto_pwhash_OPSLIMIT_INTERACTIVE;
+            params.memlimit = crypto_pwhash_MEMLIMIT_INTERACTIVE;
+            break;
+        case Profile::MODERATE:
+            params.opslimit = crypto_pwhash_OPSLIMIT_MODERATE;
+            params.memlimit = crypto_pwhash_MEMLIMIT_MODERATE;
+            break;
+        case Profile::SENSITIVE:
+            params.opslimit = crypto_pwhash_OPSLIMIT_SENSITIVE;
+            params.memlimit = crypto_pwhash_MEMLIMIT_SENSITIVE;
+            break;
+    }
+
+    // Salt can't be generated without libsodium, so parameters are left without it, which makes them invalid.
+    const int sodium = sodium_init();
+    if (sodium == -1) return params;
+
+    params.salt = std::string(crypto_pwhash_SALTBYTES, '\0');
+    randombytes_buf(&params.salt[0], params.salt.size());
+    return params;
+}
+
+bool electronpass::KdfParams::valid() const {
+    switch (algorithm) {
+        case Algorithm::SCRYPT:
+            return salt.size() == crypto_pwhash_scryptsalsa208sha256_SALTBYTES &&
+                   opslimit >= crypto_pwhash_scryptsalsa208sha256_OPSLIMIT_MIN &&
+                   opslimit <= crypto_pwhash_scryptsalsa208sha256_OPSLIMIT_SENSITIVE &&
+                   memlimit >= crypto_pwhash_scryptsalsa208sha256_MEMLIMIT_MIN &&
+                   memlimit <= crypto_pwhash_scryptsalsa208sha256_MEMLIMIT_SENSITIVE;
+        case Algorithm::ARGON2ID:
+            return salt.size() == crypto_pwhash_SALTBYTES &&
+                   opslimit >= crypto_pwhash_OPSLIMIT_MIN && opslimit <= kArgon2idMaxOpslimit &&
+                   memlimit >= crypto_pwhash_MEMLIMIT_MIN && memlimit <= crypto_pwhash_MEMLIMIT_SENSITIVE;
+    }
+    return false;
+}
+
+bool electronpass::KdfParams::operator==(const KdfParams& other) const {
+    return algorithm == other.algorithm && opslimit == other.opslimit && memlimit == other.memlimit &&
+           salt == other.salt;
+}
+
+bool electronpass::KdfParams::operator!=(const KdfParams& other) const {
+    return !(*this == other);
+}
+
+bool electronpass::Crypto::generate_key(const char* password, size_t password_len, const KdfParams& params,
+                                        unsigned char *key) {
+    if (!params.valid()) return false;
+    const unsigned char *salt = reinterpret_cast<const unsigned char *>(params.salt.data());
+
+    // Generates 32 bytes key for encryption.
+    // Salt is unique for each wallet (or a constant for legacy wallets). We are also generating a random nonce
+    // for every encrypton.
+    switch (params.algorithm) {
+        case KdfParams::Algorithm::SCRYPT:
+            return crypto_pwhash_scryptsalsa208sha256(key, crypto_box_SEEDBYTES, password, password_len, salt,
+                                                      params.opslimit, static_cast<size_t>(params.memlimit)) == 0;
+        case KdfParams::Algorithm::ARGON2ID:
+            return crypto_pwhash(key, crypto_box_SEEDBYTES, password, password_len, salt,
+                                 params.opslimit, static_cast<size_t>(params.memlimit),
+                                 crypto_pwhash_ALG_ARGON2ID13) == 0;
+    }
+    return false;
+}
+
+// Returns duration of key derivation in milliseconds or -1 if derivation failed.
+static double time_kdf(const electronpass::KdfParams& params) {
+    unsigned char key[crypto_box_SEEDBYTES];
+    const char password[] = "calibration";
+
+    auto start = std::chrono::steady_clock::now();
+    int result = crypto_pwhash(key, sizeof key, password, sizeof password - 1,
+                               reinterpret_cast<const unsigned char *>(params.salt.data()),
+                               params.opslimit, static_cast<size_t>(params.memlimit), crypto_pwhash_ALG_ARGON2ID13);
+    auto end = std::chrono::steady_clock::now();
+
+    if (result != 0) return -1;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+electronpass::KdfParams electronpass::Crypto::calibrate_kdf(unsigned int target_ms, uint64_t max_mem) {
+    KdfParams params = KdfParams::generate();
+    params.opslimit = crypto_pwhash_OPSLIMIT_MIN;
+    params.memlimit = std::min<uint64_t>(std::max<uint64_t>(max_mem, crypto_pwhash_MEMLIMIT_MIN),
+                                         crypto_pwhash_MEMLIMIT_SENSITIVE);
+
+    // Find the largest memory, for which a single pass is fast enough. Pass, that failed (usually because memory
+    // couldn't be allocated), is treated as too slow.
+    double pass_ms = time_kdf(params);
+    while ((pass_ms < 0 || pass_ms > target_ms) && params.memlimit / 2 >= crypto_pwhash_MEMLIMIT_MIN) {
+        // Time is roughly proportional to memory.
+        params.memlimit /= 2;
+        pass_ms = time_kdf(params);
+    }
+    if (pass_ms < 0) {
+        // Even the minimum memory couldn't be allocated, calibration is not possible.
+        params.opslimit = 0;
+        return params;
+    }
+
+    // Time is roughly proportional to number of passes as well.
+    if (pass_ms > 0) {
+        double passes = static_cast<double>(target_ms) / pass_ms;
+        params.opslimit = std::max<uint64_t>(crypto_pwhash_OPSLIMIT_MIN, static_cast<uint64_t>(passes));
+    }
+    params.opslimit = std::min<uint64_t>(params.opslimit, kArgon2idMaxOpslimit);
+
+    // Estimate is not exact, so check it and remove passes, which don't fit.
+    while (params.opslimit > crypto_pwhash_OPSLIMIT_MIN && time_kdf(params) > target_ms) {
+        params.opslimit = std::max<uint64_t>(crypto_pwhash_OPSLIMIT_MIN, params.opslimit * 3 / 4);
+    }
+
+    return params;
+}
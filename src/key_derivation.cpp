@@ -0,0 +1,155 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crypto.hpp"
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+namespace {
+    // Password and state of one derive_async() call, shared between the handle and the worker.
+    struct DerivationRequest {
+        electronpass::SecureString password;
+        electronpass::KdfParams kdf_params;
+        std::function<void(electronpass::DerivedKey)> callback;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::shared_ptr<electronpass::DerivedKey> result;
+        std::promise<void> done;
+        // Set by Crypto::derive_async(), because only Crypto can derive into a DerivedKey.
+        std::function<void(DerivationRequest&)> derive;
+
+        // Wipes the password and wakes up everyone waiting for the derivation.
+        void finish() {
+            electronpass::wipe(password);
+            done.set_value();
+        }
+    };
+
+    // Single thread, that runs derivations one at a time, so memory-hard derivations don't compete for memory
+    // and cores. At most one request waits for the worker: a newer request supersedes the waiting one, which is
+    // cancelled without being started. This way derivations for passwords, that the user kept retyping, are dropped.
+    class DerivationWorker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::shared_ptr<DerivationRequest> pending;
+        bool started = false;
+
+        void worker_loop() {
+            while (true) {
+                std::shared_ptr<DerivationRequest> request;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this]() { return pending != nullptr; });
+                    request.swap(pending);
+                }
+                request->derive(*request);
+                request->finish();
+            }
+        }
+
+        DerivationWorker() {}
+
+      public:
+        // Worker is never destroyed, so exit doesn't wait for a running derivation (see WorkerPool in crypto_batch.cpp).
+        static DerivationWorker& instance() {
+            static DerivationWorker *worker = new DerivationWorker();
+            return *worker;
+        }
+
+        void submit(const std::shared_ptr<DerivationRequest>& request) {
+            std::shared_ptr<DerivationRequest> superseded;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!started) {
+                    std::thread(&DerivationWorker::worker_loop, this).detach();
+                    started = true;
+                }
+                superseded.swap(pending);
+                pending = request;
+            }
+            wake.notify_one();
+
+            if (superseded) {
+                superseded->cancelled->store(true);
+                superseded->finish();
+            }
+        }
+    };
+}
+
+electronpass::KeyDerivation::KeyDerivation(): cancelled{std::make_shared<std::atomic<bool>>(false)} {}
+
+void electronpass::KeyDerivation::cancel() {
+    cancelled->store(true);
+}
+
+bool electronpass::KeyDerivation::is_cancelled() const {
+    return cancelled->load();
+}
+
+bool electronpass::KeyDerivation::ready() const {
+    return finished.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void electronpass::KeyDerivation::wait() const {
+    finished.wait();
+}
+
+electronpass::DerivedKey electronpass::KeyDerivation::get() {
+    wait();
+    DerivedKey key = std::move(*result);
+    // If derivation was cancelled after it had finished, key is wiped here.
+    if (is_cancelled()) return DerivedKey(NULL, key.params);
+    return key;
+}
+
+electronpass::KeyDerivation electronpass::Crypto::derive_async(const std::string& password,
+                                                               std::function<void(DerivedKey)> callback) {
+    return derive_async(password, KdfParams::legacy(), callback);
+}
+
+electronpass::KeyDerivation electronpass::Crypto::derive_async(const std::string& password,
+                                                               const KdfParams& kdf_params,
+                                                               std::function<void(DerivedKey)> callback) {
+    KeyDerivation derivation;
+    derivation.result = std::make_shared<DerivedKey>(DerivedKey(NULL, kdf_params));
+
+    std::shared_ptr<DerivationRequest> request = std::make_shared<DerivationRequest>();
+    // Worker gets its own copy of the password in secure memory, which is wiped when the request finishes.
+    request->password.assign(password.data(), password.size());
+    request->kdf_params = kdf_params;
+    request->callback = callback;
+    request->cancelled = derivation.cancelled;
+    request->result = derivation.result;
+    derivation.finished = request->done.get_future().share();
+
+    request->derive = [](DerivationRequest& r) {
+        if (r.cancelled->load()) return;
+
+        DerivedKey key = derive_key(r.password.data(), r.password.size(), r.kdf_params);
+
+        // Key of a cancelled derivation is wiped when it goes out of scope.
+        if (!r.cancelled->load()) {
+            if (r.callback) r.callback(std::move(key));
+            else *r.result = std::move(key);
+        }
+    };
+
+    DerivationWorker::instance().submit(request);
+    return derivation;
+}
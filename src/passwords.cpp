@@ -16,21 +16,16 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "passwords.hpp"
-#include <random>
-#include <functional>
+#include "random.hpp"
 #include <iostream>
 #include <algorithm>
 #include <set>
 #include <cassert>
+#include <cmath>
 
-// Seeds and obtains random int between min and max using mt19937 algorithm.
+// Obtains unbiased random int between min and max from cryptographically secure generator.
 int true_random_int(int min, int max) {
-    std::mt19937 prng;
-    std::mt19937::result_type seed = std::random_device{}();
-    prng.seed(seed);
-    auto randGen = std::bind(std::uniform_int_distribution<int>(min, max),
-                             std::mt19937(seed));
-    return randGen();
+    return min + static_cast<int>(electronpass::Random::uniform(static_cast<uint32_t>(max - min + 1)));
 }
 
 // Rewrites string without n-th char and returns it.
@@ -0,0 +1,89 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "crypto.hpp"
+
+// Cost of deriving key from PIN. Argon2id with minimal number of passes and 8 MiB of memory takes a few
+// milliseconds.
+#define kQuickUnlockMemlimit (8 * 1024 * 1024)
+
+electronpass::QuickUnlock::QuickUnlock(const DerivedKey& key, const std::string& pin,
+                                       std::chrono::seconds timeout_, unsigned int max_attempts_):
+        params(key.kdf_params()), max_attempts{max_attempts_}, remaining_attempts{max_attempts_}, timeout{timeout_},
+        deadline{std::chrono::steady_clock::now() + timeout_} {
+    pin_params = KdfParams::generate();
+    pin_params.opslimit = crypto_pwhash_OPSLIMIT_MIN;
+    pin_params.memlimit = kQuickUnlockMemlimit;
+
+    Crypto pin_crypto(pin, pin_params);
+    sealed.resize(Crypto::WRAPPED_KEY_BYTES);
+    if (!pin_crypto.wrap_key(key, sealed.data())) lock();
+}
+
+electronpass::QuickUnlock& electronpass::QuickUnlock::operator=(QuickUnlock&& other) {
+    if (this != &other) {
+        lock();
+        sealed = std::move(other.sealed);
+        params = std::move(other.params);
+        pin_params = std::move(other.pin_params);
+        max_attempts = other.max_attempts;
+        remaining_attempts = other.remaining_attempts;
+        timeout = other.timeout;
+        deadline = other.deadline;
+        other.lock();
+    }
+    return *this;
+}
+
+electronpass::QuickUnlock::~QuickUnlock() {
+    lock();
+}
+
+electronpass::DerivedKey electronpass::QuickUnlock::unlock(const std::string& pin) {
+    if (!lock_if_expired()) return DerivedKey(NULL, params);
+
+    DerivedKey key = Crypto(pin, pin_params).unwrap_key(sealed.data(), sealed.size());
+    if (!key.check()) {
+        if (--remaining_attempts == 0) lock();
+        return DerivedKey(NULL, params);
+    }
+
+    remaining_attempts = max_attempts;
+    deadline = std::chrono::steady_clock::now() + timeout;
+    key.params = params;
+    return key;
+}
+
+void electronpass::QuickUnlock::lock() {
+    if (!sealed.empty()) sodium_memzero(sealed.data(), sealed.size());
+    sealed.clear();
+    remaining_attempts = 0;
+}
+
+bool electronpass::QuickUnlock::lock_if_expired() {
+    if (!sealed.empty() && std::chrono::steady_clock::now() >= deadline) lock();
+    return active();
+}
+
+bool electronpass::QuickUnlock::active() const {
+    return !sealed.empty() && remaining_attempts > 0 && std::chrono::steady_clock::now() < deadline;
+}
+
+unsigned int electronpass::QuickUnlock::attempts_left() const {
+    return active() ? remaining_attempts : 0;
+}
@@ -0,0 +1,144 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "random.hpp"
+#include <sodium.h>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// Bytes of each key stream buffer, that become the next key.
+#define kRandomKeyBytes crypto_stream_chacha20_KEYBYTES
+
+const size_t electronpass::Random::BUFFER_BYTES;
+
+namespace {
+    // Incremented in the child process after fork(), so generators, copied from the parent, are seeded again.
+    std::atomic<unsigned int> fork_generation(0);
+
+    void after_fork() {
+        fork_generation.fetch_add(1);
+    }
+
+    // Key stream of ChaCha20 with fast key erasure.
+    class Generator {
+        unsigned char key[kRandomKeyBytes];
+        unsigned char buffer[electronpass::Random::BUFFER_BYTES];
+        // Unused bytes are at the end of buffer.
+        size_t available;
+        bool seeded;
+        unsigned int generation;
+
+        void seed() {
+#ifndef _WIN32
+            static const bool registered = pthread_atfork(NULL, NULL, after_fork) == 0;
+            (void) registered;
+#endif
+            // randombytes_buf() aborts if system random is not available.
+            sodium_init();
+            randombytes_buf(key, sizeof key);
+            generation = fork_generation.load();
+            seeded = true;
+        }
+
+        void refill() {
+            // Key changes with every buffer, so nonce doesn't have to.
+            static const unsigned char nonce[crypto_stream_chacha20_NONCEBYTES] = {0};
+            crypto_stream_chacha20(buffer, sizeof buffer, nonce, key);
+            std::memcpy(key, buffer, sizeof key);
+            sodium_memzero(buffer, sizeof key);
+            available = sizeof buffer - sizeof key;
+        }
+
+      public:
+        Generator(): available{0}, seeded{false}, generation{0} {}
+
+        ~Generator() {
+            sodium_memzero(key, sizeof key);
+            sodium_memzero(buffer, sizeof buffer);
+        }
+
+        void take(unsigned char *output, size_t len) {
+            if (!seeded || generation != fork_generation.load(std::memory_order_relaxed)) {
+                seed();
+                available = 0;
+            }
+
+            while (len > 0) {
+                if (available == 0) refill();
+
+                const size_t n = std::min(len, available);
+                unsigned char *begin = buffer + sizeof buffer - available;
+                std::memcpy(output, begin, n);
+                sodium_memzero(begin, n);
+                available -= n;
+                output += n;
+                len -= n;
+            }
+        }
+    };
+
+    thread_local Generator generator;
+}
+
+void electronpass::Random::bytes(void *buffer, size_t len) {
+    unsigned char *output = static_cast<unsigned char *>(buffer);
+    if (len <= BUFFER_BYTES) {
+        generator.take(output, len);
+        return;
+    }
+
+    // Long output is generated directly with a one-time key from the generator.
+    unsigned char key[kRandomKeyBytes];
+    static const unsigned char nonce[crypto_stream_chacha20_NONCEBYTES] = {0};
+    generator.take(key, sizeof key);
+    crypto_stream_chacha20(output, len, nonce, key);
+    sodium_memzero(key, sizeof key);
+}
+
+uint32_t electronpass::Random::uint32() {
+    uint32_t value;
+    generator.take(reinterpret_cast<unsigned char *>(&value), sizeof value);
+    return value;
+}
+
+uint64_t electronpass::Random::uint64() {
+    uint64_t value;
+    generator.take(reinterpret_cast<unsigned char *>(&value), sizeof value);
+    return value;
+}
+
+uint32_t electronpass::Random::uniform(uint32_t upper_bound) {
+    if (upper_bound < 2) return 0;
+
+    // High 32 bits of random * upper_bound are uniform, except when low 32 bits fall below 2^32 mod upper_bound.
+    uint64_t product = static_cast<uint64_t>(uint32()) * upper_bound;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < upper_bound) {
+        const uint32_t threshold = (0u - upper_bound) % upper_bound;
+        while (low < threshold) {
+            product = static_cast<uint64_t>(uint32()) * upper_bound;
+            low = static_cast<uint32_t>(product);
+        }
+    }
+    return static_cast<uint32_t>(product >> 32);
+}
@@ -0,0 +1,127 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "secure_memory.hpp"
+#include <cstring>
+#include <algorithm>
+
+const size_t electronpass::SecureArena::SIZE_CLASSES;
+const size_t electronpass::SecureArena::REGION_BYTES;
+const size_t electronpass::SecureArena::MIN_BLOCK_BYTES;
+const size_t electronpass::SecureArena::MAX_BLOCK_BYTES;
+
+namespace {
+    // Index of the smallest size class, that can hold size bytes.
+    size_t size_class(size_t size) {
+        size_t index = 0;
+        while ((electronpass::SecureArena::MIN_BLOCK_BYTES << index) < size) ++index;
+        return index;
+    }
+
+    // Memory from sodium_malloc is only aligned if its size is a multiple of the alignment.
+    size_t aligned_size(size_t size) {
+        const size_t alignment = electronpass::SecureArena::MIN_BLOCK_BYTES;
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
+
+electronpass::SecureArena::SecureArena(): region_begin{NULL}, region_end{NULL}, region_count{0}, used_bytes{0} {
+    for (size_t i = 0; i < SIZE_CLASSES; ++i) free_lists[i] = NULL;
+    // Sodium has to be initialized before sodium_malloc is used.
+    sodium_init();
+}
+
+electronpass::SecureArena& electronpass::SecureArena::instance() {
+    // Intentionally never deleted, see documentation.
+    static SecureArena *arena = new SecureArena();
+    return *arena;
+}
+
+void *electronpass::SecureArena::allocate(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (size > MAX_BLOCK_BYTES) {
+        void *p = sodium_malloc(aligned_size(size));
+        if (p != NULL) used_bytes += size;
+        return p;
+    }
+
+    const size_t index = size_class(size);
+    const size_t block = MIN_BLOCK_BYTES << index;
+
+    if (free_lists[index] != NULL) {
+        // Free blocks store pointer to the next free block at their beginning. Everything else is already wiped.
+        void *p = free_lists[index];
+        std::memcpy(&free_lists[index], p, sizeof(void *));
+        sodium_memzero(p, sizeof(void *));
+        used_bytes += block;
+        return p;
+    }
+
+    if (static_cast<size_t>(region_end - region_begin) < block) {
+        // Rest of the current region is split into free blocks, so it isn't wasted.
+        while (static_cast<size_t>(region_end - region_begin) >= MIN_BLOCK_BYTES) {
+            const size_t left = static_cast<size_t>(region_end - region_begin);
+            size_t rest = std::min(size_class(left), SIZE_CLASSES - 1);
+            if ((MIN_BLOCK_BYTES << rest) > left) --rest;
+            std::memcpy(region_begin, &free_lists[rest], sizeof(void *));
+            free_lists[rest] = region_begin;
+            region_begin += MIN_BLOCK_BYTES << rest;
+        }
+
+        unsigned char *region = static_cast<unsigned char *>(sodium_malloc(REGION_BYTES));
+        if (region == NULL) return NULL;
+        region_begin = region;
+        region_end = region + REGION_BYTES;
+        ++region_count;
+    }
+
+    void *p = region_begin;
+    region_begin += block;
+    used_bytes += block;
+    return p;
+}
+
+void electronpass::SecureArena::deallocate(void *p, size_t size) {
+    if (p == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (size > MAX_BLOCK_BYTES) {
+        // sodium_free wipes memory before freeing it.
+        sodium_free(p);
+        used_bytes -= size;
+        return;
+    }
+
+    const size_t index = size_class(size);
+    const size_t block = MIN_BLOCK_BYTES << index;
+    sodium_memzero(p, block);
+    std::memcpy(p, &free_lists[index], sizeof(void *));
+    free_lists[index] = p;
+    used_bytes -= block;
+}
+
+size_t electronpass::SecureArena::allocated_bytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_bytes;
+}
+
+size_t electronpass::SecureArena::regions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return region_count;
+}
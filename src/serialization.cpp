@@ -16,133 +16,1029 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <iostream>
+#include <iterator>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
 #include "serialization.hpp"
+#include "json_parser.hpp"
+#include "wallet_payload.hpp"
+#include "compression.hpp"
+#include "file_io.hpp"
+#include "wallet_json.hpp"
 
-#define kWalletVersion 0
+// Version of binary wallets (legacy JSON wallets are version 0). Wallet is encoded as binary payload (see
+// wallet_payload.hpp) and encrypted with a random data key, which is stored in the header wrapped with the
+// password key.
+#define kWalletBinaryVersion 6
+
+// Flags of binary wallets: wallet is encrypted in segments (see Crypto::encrypt_segmented()) and payload is
+// compressed before it is encrypted (see compression.hpp).
+#define kFlagSegmented 1
+#define kFlagCompressedLz 2
+#define kFlagCompressedZlib 4
+#define kKnownFlags (kFlagSegmented | kFlagCompressedLz | kFlagCompressedZlib)
+
+// Compressed payload can't declare a larger size, so corrupted wallet can't make load() allocate more memory.
+#define kMaxDecompressedBytes (static_cast<size_t>(1) << 30)
+
+// Binary wallets start with magic bytes, followed by version and timestamp.
+#define kWalletMagic "EPWL"
+#define kWalletMagicSize 4
+
+// Wallets saved to a stream use secret stream instead of one of the Cipher algorithms.
+#define kCipherSecretStream 1
+
+// Legacy JSON wallets are read from a stream in chunks of this size.
+#define kLegacyChunkBytes (64 * 1024)
+
+// Initial capacity of serialized wallet for each item.
+#define kSerializedItemBytes 256
 
 using namespace electronpass;
 
-Wallet serialization::deserialize(const std::string& json) {
-    Json::Value root;
-    Json::Reader reader;
-    reader.parse(json.c_str(), root);
+namespace {
+    // Read only stream buffer over existing memory, so data doesn't have to be copied into a stringstream.
+    class MemoryBuffer : public std::streambuf {
+      public:
+        MemoryBuffer(const char *data, size_t len) {
+            char *begin = const_cast<char *>(data);
+            setg(begin, begin, begin + len);
+        }
+
+        MemoryBuffer(const std::string& data): MemoryBuffer(data.data(), data.size()) {}
+    };
+
+    // Stream buffer, which appends everything written to it to a string.
+    template <typename String>
+    class StringSink : public std::streambuf {
+        String& output;
+
+      protected:
+        std::streamsize xsputn(const char *s, std::streamsize n) override {
+            output.append(s, static_cast<size_t>(n));
+            return n;
+        }
+
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) output.push_back(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+
+      public:
+        StringSink(String& output_): output{output_} {}
+    };
 
-    std::map<std::string, Wallet::Item> items;
+    // Builds wallet from JsonParser events. Strings are written directly into items and fields, which are moved into
+    // the wallet, so no JSON tree is built. Unknown keys and values of unexpected types are ignored.
+    class WalletBuilder : public JsonHandler {
+        enum class Context {
+            ROOT, ITEMS, ITEM, FIELDS, FIELD, SKIP
+        };
 
-    Json::Value::Members raw_items = root["items"].getMemberNames();
-    for (std::string id : raw_items) {
-        Json::Value raw_item = root["items"][id];
-        std::string name = raw_item["name"].asString();
-        uint64_t last_edited = raw_item["last_edited"].asUInt64();
+        struct Frame {
+            Context context;
+            // Key of the current value, if frame is an object.
+            std::string key;
+        };
 
-        std::vector<Wallet::Field> fields;
-        Json::Value raw_fields = raw_item["fields"];
-        for (Json::Value raw_field : raw_fields) {
-            std::string field_name = raw_field["name"].asString();
-            std::string field_value = raw_field["value"].asString();
-            bool sensitive = raw_field["sensitive"].asBool();
-            Wallet::FieldType field_type = Wallet::string_to_field_type(raw_field["type"].asString());
+        std::vector<Frame> stack;
+        std::vector<Wallet::Item> items;
 
-            Wallet::Field field(field_name, field_value, field_type, sensitive);
-            fields.push_back(field);
+        // Item and field, that are being read.
+        ItemId item_id;
+        std::string item_name, field_type;
+        uint64_t item_last_edited = 0;
+        std::vector<Wallet::Field> item_fields;
+        Wallet::Field field;
+
+        // Context of a new object or array in the current position.
+        Context child_context(bool object) const {
+            if (stack.empty()) return object ? Context::ROOT : Context::SKIP;
+
+            const Frame& parent = stack.back();
+            switch (parent.context) {
+                case Context::ROOT:
+                    return object && parent.key == "items" ? Context::ITEMS : Context::SKIP;
+                case Context::ITEMS:
+                    return object ? Context::ITEM : Context::SKIP;
+                case Context::ITEM:
+                    return !object && parent.key == "fields" ? Context::FIELDS : Context::SKIP;
+                case Context::FIELDS:
+                    return object ? Context::FIELD : Context::SKIP;
+                default:
+                    return Context::SKIP;
+            }
+        }
+
+        // Key of the current value in context, empty if value is not inside of such object.
+        const std::string *current_key(Context context) const {
+            if (stack.empty() || stack.back().context != context) return NULL;
+            return &stack.back().key;
+        }
+
+      public:
+        bool start_object() override {
+            const Context context = child_context(true);
+            if (context == Context::ITEM) {
+                item_id = stack.back().key;
+                item_name.clear();
+                item_last_edited = 0;
+                item_fields.clear();
+            } else if (context == Context::FIELD) {
+                field = Wallet::Field("", "", Wallet::FieldType::UNDEFINED, false);
+                field_type.clear();
+            }
+            stack.push_back(Frame{context, ""});
+            return true;
+        }
+
+        bool end_object() override {
+            const Context context = stack.back().context;
+            stack.pop_back();
+            if (context == Context::ITEM) {
+                items.push_back(Wallet::Item("", std::move(item_id), item_last_edited));
+                items.back().name = std::move(item_name);
+                items.back().fields = std::move(item_fields);
+            } else if (context == Context::FIELD) {
+                field.field_type = Wallet::string_to_field_type(field_type);
+                item_fields.push_back(std::move(field));
+            }
+            return true;
         }
 
-        Wallet::Item item(name, fields, id, last_edited);
-        items[id] = item;
+        bool start_array() override {
+            stack.push_back(Frame{child_context(false), ""});
+            return true;
+        }
+
+        bool end_array() override {
+            stack.pop_back();
+            return true;
+        }
+
+        bool key(const std::string& key) override {
+            stack.back().key = key;
+            return true;
+        }
+
+        bool string_part(const char *s, size_t len) override {
+            if (const std::string *key = current_key(Context::FIELD)) {
+                if (*key == "value") field.value.append(s, len);
+                else if (*key == "name") field.name.append(s, len);
+                else if (*key == "type") field_type.append(s, len);
+            } else if ((key = current_key(Context::ITEM)) && *key == "name") {
+                item_name.append(s, len);
+            }
+            return true;
+        }
+
+        bool string_end() override {
+            return true;
+        }
+
+        bool number(const std::string& number) override {
+            const std::string *key = current_key(Context::ITEM);
+            if (!key || *key != "last_edited") return true;
+
+            // Timestamps are integers, but other numbers are converted like they were by Json::Value::asUInt64().
+            char *end;
+            item_last_edited = std::strtoull(number.c_str(), &end, 10);
+            if (*end != '\0' || number[0] == '-') {
+                const double value = std::strtod(number.c_str(), NULL);
+                item_last_edited = value >= 0 && value < 18446744073709551616.0 ? static_cast<uint64_t>(value) : 0;
+            }
+            return true;
+        }
+
+        bool boolean(bool value) override {
+            const std::string *key = current_key(Context::FIELD);
+            if (key && *key == "sensitive") field.sensitive = value;
+            return true;
+        }
+
+        bool null() override {
+            return true;
+        }
+
+        // Takes the built wallet.
+        Wallet wallet() {
+            return Wallet(std::move(items));
+        }
+    };
+
+    // Deserializes wallet from JSON in memory. Valid is set to false if JSON is invalid, in which case wallet is empty.
+    Wallet deserialize_json(const char *begin, const char *end, bool& valid) {
+        WalletBuilder builder;
+        JsonParser parser(builder);
+        valid = parser.feed(begin, static_cast<size_t>(end - begin)) && parser.finish();
+        return valid ? builder.wallet() : Wallet();
     }
 
-    return Wallet(items);
-}
+    // Item of a wallet with its id, which is used as key in JSON.
+    struct SortedItem {
+        std::string id;
+        const Wallet::Item *item;
 
-std::string serialization::serialize(const Wallet& wallet) {
-    Json::Value root;
-    root["items"] = Json::Value();
+        bool operator<(const SortedItem& other) const {
+            return id < other.id;
+        }
+    };
 
-    std::vector<std::string> ids = wallet.get_ids();
-    for (std::string id : ids) {
-        Json::Value item;
-        item["name"] = wallet[id].name;
-        item["last_edited"] = wallet[id].last_edited;
+    // Items of the wallet by reference, sorted by their ids as strings (the order in which jsoncpp wrote them).
+    std::vector<SortedItem> sorted_items(const Wallet& wallet) {
+        std::vector<ItemId> ids = wallet.get_item_ids();
+        std::vector<SortedItem> items;
+        items.reserve(ids.size());
+        for (const ItemId& id : ids) items.push_back(SortedItem{id.to_string(), &wallet.get_item(id)});
+        std::sort(items.begin(), items.end());
+        return items;
+    }
 
-        std::vector<Wallet::Field> fields = wallet[id].fields;
-        Json::Value json_fields;
-        for (unsigned int j = 0; j < fields.size(); ++j) {
-            Json::Value field;
-            field["name"] = fields[j].name;
-            field["type"] = Wallet::field_type_to_string(fields[j].field_type);
-            field["value"] = fields[j].value;
-            field["sensitive"] = fields[j].sensitive;
-            json_fields[j] = field;
+    // Escape sequence of characters, that jsoncpp escapes with two characters, otherwise NULL.
+    const char *short_escape(char c) {
+        switch (c) {
+            case '"': return "\\\"";
+            case '\\': return "\\\\";
+            case '\b': return "\\b";
+            case '\f': return "\\f";
+            case '\n': return "\\n";
+            case '\r': return "\\r";
+            case '\t': return "\\t";
+            default: return NULL;
         }
+    }
 
-        item["fields"] = json_fields;
-        root["items"][id] = item;
+    bool is_control(char c) {
+        return static_cast<unsigned char>(c) < 0x20;
     }
 
-    Json::StreamWriterBuilder builder;
-    builder.settings_["indentation"] = "";
-    return Json::writeString(builder, root);
-}
+    bool needs_escape(char c) {
+        return is_control(c) || c == '"' || c == '\\';
+    }
 
-electronpass::Wallet serialization::load(const std::string &data, const Crypto &crypto, int &error) {
-    Json::Value json;
-    Json::Reader reader;
-    if (!reader.parse(data, json)) {
-        error = 2;
-        return Wallet();
+    // Number of characters at the start of s, that don't have to be escaped. Most strings don't have any characters,
+    // that have to be escaped, so they are checked 8 at a time.
+    size_t plain_prefix(const char *s, size_t len) {
+        const uint64_t ones = 0x0101010101010101ULL, high = 0x8080808080808080ULL;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, s + i, 8);
+            const uint64_t quote = word ^ (ones * '"'), backslash = word ^ (ones * '\\');
+            // High bit is set in bytes smaller than 0x20 and bytes equal to 0 after xor.
+            const uint64_t special = ((word - ones * 0x20) & ~word) | ((quote - ones) & ~quote) |
+                                     ((backslash - ones) & ~backslash);
+            if (special & high) break;
+        }
+        while (i < len && !needs_escape(s[i])) ++i;
+        return i;
+    }
+
+    // Appends JSON to a string. Strings are escaped the same way as by jsoncpp.
+    template <typename String>
+    class JsonOutput {
+        String& output;
+
+        // Makes room for len more characters. String is not left to reallocate itself, because JSON contains plain
+        // text, so old buffer has to be wiped before it is freed.
+        void reserve(size_t len) {
+            if (output.size() + len <= output.capacity()) return;
+
+            String grown;
+            grown.reserve(std::max(output.capacity() * 2, output.size() + len));
+            grown.append(output);
+            wipe(output);
+            output.swap(grown);
+        }
+
+      public:
+        JsonOutput(String& output_, size_t capacity): output{output_} {
+            output.reserve(capacity);
+        }
+
+        void raw(const char *s, size_t len) {
+            reserve(len);
+            output.append(s, len);
+        }
+
+        void quoted(const char *s, size_t len) {
+            static const char hex[] = "0123456789ABCDEF";
+
+            // At most 6 characters for each character and quotes.
+            reserve(len * 6 + 2);
+            output.push_back('"');
+            size_t i = 0;
+            while (true) {
+                // Characters, that don't have to be escaped, are appended together.
+                const size_t plain = plain_prefix(s + i, len - i);
+                output.append(s + i, plain);
+                i += plain;
+                if (i == len) break;
+
+                if (const char *escape = short_escape(s[i])) {
+                    output.append(escape, 2);
+                } else {
+                    const char unicode[] = {'\\', 'u', '0', '0', hex[(s[i] >> 4) & 0xf], hex[s[i] & 0xf]};
+                    output.append(unicode, sizeof unicode);
+                }
+                ++i;
+            }
+            output.push_back('"');
+        }
+    };
+
+    template <typename String>
+    void write_literal(JsonOutput<String>& output, const char *s) {
+        output.raw(s, std::strlen(s));
+    }
+
+    // Writes wallet JSON with keys in the same order and format as Json::StreamWriterBuilder without indentation.
+    template <typename String>
+    void write_wallet(JsonOutput<String>& output, const std::vector<SortedItem>& items) {
+        if (items.empty()) {
+            write_literal(output, "{\"items\":null}");
+            return;
+        }
+
+        write_literal(output, "{\"items\":{");
+        for (size_t i = 0; i < items.size(); ++i) {
+            const Wallet::Item& item = *items[i].item;
+            if (i > 0) write_literal(output, ",");
+            output.quoted(items[i].id.data(), items[i].id.size());
+
+            write_literal(output, ":{\"fields\":");
+            if (item.fields.empty()) write_literal(output, "null");
+            for (size_t j = 0; j < item.fields.size(); ++j) {
+                const Wallet::Field& field = item.fields[j];
+                write_literal(output, j == 0 ? "[{\"name\":" : ",{\"name\":");
+                output.quoted(field.name.data(), field.name.size());
+                write_literal(output, field.sensitive ? ",\"sensitive\":true,\"type\":" : ",\"sensitive\":false,\"type\":");
+                const std::string type = Wallet::field_type_to_string(field.field_type);
+                output.quoted(type.data(), type.size());
+                write_literal(output, ",\"value\":");
+                output.quoted(field.value.data(), field.value.size());
+                write_literal(output, "}");
+            }
+            if (!item.fields.empty()) write_literal(output, "]");
+
+            char digits[20];
+            size_t digits_len = 0;
+            uint64_t last_edited = item.last_edited;
+            do {
+                digits[sizeof digits - ++digits_len] = static_cast<char>('0' + last_edited % 10);
+                last_edited /= 10;
+            } while (last_edited > 0);
+            write_literal(output, ",\"last_edited\":");
+            output.raw(digits + sizeof digits - digits_len, digits_len);
+
+            write_literal(output, ",\"name\":");
+            output.quoted(item.name.data(), item.name.size());
+            write_literal(output, "}");
+        }
+        write_literal(output, "}}");
+    }
+
+    // Writes unsigned integer in little-endian byte order.
+    void write_uint(std::ostream& out, uint64_t value, int bytes) {
+        char buffer[8];
+        for (int i = 0; i < bytes; ++i) buffer[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        out.write(buffer, bytes);
+    }
+
+    // Reads little-endian unsigned integer. Returns false if there is not enough data.
+    bool read_uint(std::istream& in, uint64_t& value, int bytes) {
+        unsigned char buffer[8];
+        in.read(reinterpret_cast<char *>(buffer), bytes);
+        if (in.gcount() != bytes) return false;
+
+        value = 0;
+        for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+        return true;
+    }
+
+    // Header of binary wallet.
+    struct Header {
+        uint64_t version;
+        uint64_t timestamp;
+        KdfParams kdf;
+        uint64_t cipher;
+        uint64_t flags;
+        std::string key_check;
+        std::string wrapped_key;
+    };
+
+    Header new_header(uint64_t timestamp, const KdfParams& kdf, uint64_t cipher, uint64_t flags) {
+        Header header;
+        header.version = kWalletBinaryVersion;
+        header.timestamp = timestamp;
+        header.kdf = kdf;
+        header.cipher = cipher;
+        header.flags = flags;
+        return header;
+    }
+
+    // Serializes header, including magic bytes. Serialized header is also used as additional data for encryption,
+    // so it can't be changed without failing authentication.
+    std::string write_header(const Header& header) {
+        std::string result;
+        StringSink<std::string> sink(result);
+        std::ostream out(&sink);
+
+        out.write(kWalletMagic, kWalletMagicSize);
+        write_uint(out, header.version, 2);
+        write_uint(out, header.timestamp, 8);
+        write_uint(out, static_cast<uint64_t>(header.kdf.algorithm), 1);
+        write_uint(out, header.kdf.opslimit, 8);
+        write_uint(out, header.kdf.memlimit, 8);
+        write_uint(out, header.kdf.salt.size(), 1);
+        out.write(header.kdf.salt.data(), header.kdf.salt.size());
+        write_uint(out, header.cipher, 1);
+        write_uint(out, header.flags, 1);
+        out.write(header.key_check.data(), header.key_check.size());
+        out.write(header.wrapped_key.data(), header.wrapped_key.size());
+        return result;
+    }
+
+    // Checks if wallet cipher is one of Cipher values and can be used on this device.
+    bool cipher_supported(uint64_t cipher) {
+        switch (cipher) {
+            case static_cast<uint64_t>(Cipher::CHACHA20_POLY1305):
+            case static_cast<uint64_t>(Cipher::XCHACHA20_POLY1305):
+            case static_cast<uint64_t>(Cipher::AES256_GCM):
+                return Crypto::cipher_available(static_cast<Cipher>(cipher));
+            default:
+                return false;
+        }
     }
 
-    try {
-        if (json["timestamp"].empty() || json["data"].empty() || json["version"].empty()) {
+    // Reads header of binary wallet, after magic bytes were already read. Returns error code for load().
+    int read_header(std::istream& in, Header& header) {
+        if (!read_uint(in, header.version, 2) || !read_uint(in, header.timestamp, 8)) return 2;
+        if (header.version != kWalletBinaryVersion) return 2;
+
+        uint64_t algorithm, salt_len;
+        if (!read_uint(in, algorithm, 1) || !read_uint(in, header.kdf.opslimit, 8) ||
+            !read_uint(in, header.kdf.memlimit, 8) || !read_uint(in, salt_len, 1)) {
+            return 2;
+        }
+        header.kdf.algorithm = static_cast<KdfParams::Algorithm>(algorithm);
+        header.kdf.salt.resize(salt_len);
+        in.read(&header.kdf.salt[0], salt_len);
+        if (in.gcount() != static_cast<std::streamsize>(salt_len) || !read_uint(in, header.cipher, 1) ||
+            !read_uint(in, header.flags, 1)) {
+            return 2;
+        }
+
+        header.key_check.resize(Crypto::KEY_CHECK_BYTES);
+        in.read(&header.key_check[0], header.key_check.size());
+        if (in.gcount() != static_cast<std::streamsize>(header.key_check.size())) return 2;
+        header.wrapped_key.resize(Crypto::WRAPPED_KEY_BYTES);
+        in.read(&header.wrapped_key[0], header.wrapped_key.size());
+        if (in.gcount() != static_cast<std::streamsize>(header.wrapped_key.size())) return 2;
+
+        if (header.flags & ~static_cast<uint64_t>(kKnownFlags)) return 2;
+        if ((header.flags & kFlagCompressedLz) && (header.flags & kFlagCompressedZlib)) return 2;
+
+        // Parameters are untrusted, they must be checked before key is derived with them.
+        if (!header.kdf.valid()) return 2;
+        // AES-256-GCM wallets can't be decrypted on devices without hardware AES support.
+        if (header.cipher == kCipherSecretStream) return header.flags & kFlagSegmented ? 2 : 0;
+        if (!cipher_supported(header.cipher)) return 2;
+        return 0;
+    }
+
+    // Additional data for encrypting wallet. Key derivation parameters and wrapped key are authenticated by wrapping
+    // instead, so password can be changed without encrypting the wallet again.
+    std::string additional_data(const Header& header) {
+        std::string result;
+        StringSink<std::string> sink(result);
+        std::ostream out(&sink);
+        out.write(kWalletMagic, kWalletMagicSize);
+        write_uint(out, header.version, 2);
+        write_uint(out, header.timestamp, 8);
+        write_uint(out, header.cipher, 1);
+        write_uint(out, header.flags, 1);
+        return result;
+    }
+
+    // Additional data for wrapping data key: whole header without the wrapped key.
+    std::string wrap_additional_data(Header header) {
+        header.wrapped_key.clear();
+        return write_header(header);
+    }
+
+    // Wraps data key with crypto's key and stores it into header, together with key check value.
+    bool wrap_data_key(Header& header, const Crypto& crypto, const DerivedKey& data_key) {
+        header.key_check = crypto.key_check();
+        const std::string ad = wrap_additional_data(header);
+        header.wrapped_key.assign(Crypto::WRAPPED_KEY_BYTES, '\0');
+        return crypto.wrap_key(data_key, reinterpret_cast<unsigned char *>(&header.wrapped_key[0]),
+                               reinterpret_cast<const unsigned char *>(ad.data()), ad.size());
+    }
+
+    // Unwraps data key from header. Returns invalid key if password is wrong or header was changed.
+    DerivedKey unwrap_data_key(const Header& header, const Crypto& crypto) {
+        const std::string ad = wrap_additional_data(header);
+        return crypto.unwrap_key(reinterpret_cast<const unsigned char *>(header.wrapped_key.data()),
+                                 header.wrapped_key.size(), reinterpret_cast<const unsigned char *>(ad.data()),
+                                 ad.size());
+    }
+
+    // Checks if crypto can open wallet with given header, without decrypting anything. Returns error code for load().
+    int check_crypto(const Header& header, const Crypto& crypto) {
+        // Wallet was encrypted with a key derived with different parameters.
+        if (header.kdf != crypto.kdf_params()) return 3;
+        // Wrong password is detected by key check value, before anything is decrypted.
+        if (!crypto.verify_key_check(header.key_check)) return 4;
+        return 0;
+    }
+
+    // Compression of payload, as recorded in header flags.
+    serialization::Compression header_compression(const Header& header) {
+        if (header.flags & kFlagCompressedLz) return serialization::Compression::LZ;
+        if (header.flags & kFlagCompressedZlib) return serialization::Compression::ZLIB;
+        return serialization::Compression::NONE;
+    }
+
+    // Encodes wallet into payload and compresses it. Compressed payload is only used if it is smaller, in which case
+    // its flag is added to flags. Returns false if compression is not available.
+    bool encode_payload(const Wallet& wallet, serialization::Compression compression, SecureString& payload,
+                        uint64_t& flags) {
+        payload = payload::encode(wallet);
+        if (compression == serialization::Compression::NONE) return true;
+
+        SecureString compressed;
+        if (!compression::compress(compression, payload.data(), payload.size(), compressed)) {
+            wipe(payload);
+            wipe(compressed);
+            return false;
+        }
+        if (compressed.size() < payload.size()) {
+            wipe(payload);
+            payload.swap(compressed);
+            flags |= compression == serialization::Compression::LZ ? kFlagCompressedLz : kFlagCompressedZlib;
+        } else {
+            wipe(compressed);
+        }
+        return true;
+    }
+
+    // Loads binary wallet. Magic bytes were already read from the stream. If stream is reading from memory,
+    // data_end points to the end of that memory, so single message wallets can be decrypted without copying.
+    Wallet load_binary(std::istream& in, const char *data_end, const Crypto& crypto, int& error) {
+        Header header;
+        error = read_header(in, header);
+        if (error != 0) return Wallet();
+
+        error = check_crypto(header, crypto);
+        if (error != 0) return Wallet(header.timestamp);
+
+        // Wallet is encrypted with a data key, which is wrapped with the password key.
+        DerivedKey data_key = unwrap_data_key(header, crypto);
+        if (!data_key.check()) {
+            error = 1;
+            return Wallet(header.timestamp);
+        }
+        const Crypto data_crypto(data_key);
+
+        const std::string ad = additional_data(header);
+        // Decrypted wallet is kept in SecureArena.
+        SecureString wallet_string;
+        bool decrypt;
+
+        if (header.cipher == kCipherSecretStream) {
+            StringSink<SecureString> sink(wallet_string);
+            std::ostream out(&sink);
+            decrypt = data_crypto.decrypt_stream(in, out, ad);
+        } else {
+            std::string body;
+            const char *cipher_text;
+            size_t cipher_text_len;
+            if (data_end != NULL) {
+                cipher_text_len = static_cast<size_t>(in.rdbuf()->in_avail());
+                cipher_text = data_end - cipher_text_len;
+            } else {
+                body.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                cipher_text = body.data();
+                cipher_text_len = body.size();
+            }
+
+            const Cipher cipher = static_cast<Cipher>(header.cipher);
+            const unsigned char *raw = reinterpret_cast<const unsigned char *>(cipher_text);
+            const unsigned char *raw_ad = reinterpret_cast<const unsigned char *>(ad.data());
+            if (header.flags & kFlagSegmented) {
+                wallet_string.resize(Crypto::segmented_plain_text_size(cipher_text_len, cipher));
+                decrypt = data_crypto.decrypt_segmented(raw, cipher_text_len,
+                                                        reinterpret_cast<unsigned char *>(&wallet_string[0]),
+                                                        wallet_string.size(), raw_ad, ad.size(), cipher);
+            } else {
+                wallet_string.resize(Crypto::plain_text_size(cipher_text_len, cipher));
+                decrypt = data_crypto.decrypt(raw, cipher_text_len,
+                                              reinterpret_cast<unsigned char *>(&wallet_string[0]),
+                                              wallet_string.size(), raw_ad, ad.size(), cipher);
+            }
+        }
+
+        if (!decrypt) {
+            error = 1;
+            return Wallet(header.timestamp);
+        }
+
+        const serialization::Compression compression = header_compression(header);
+        if (compression != serialization::Compression::NONE) {
+            SecureString decompressed;
+            if (!compression::decompress(compression, wallet_string.data(), wallet_string.size(), decompressed,
+                                         kMaxDecompressedBytes)) {
+                error = 2;
+                return Wallet(header.timestamp);
+            }
+            wallet_string.swap(decompressed);
+        }
+
+        bool valid;
+        Wallet wallet = payload::decode(wallet_string.data(), wallet_string.size(), valid);
+        if (!valid) {
+            error = 2;
+            return Wallet(header.timestamp);
+        }
+        wallet.timestamp = header.timestamp;
+        error = 0;
+        return wallet;
+    }
+
+    // Reads legacy JSON wallet ({"data": ..., "timestamp": ..., "version": ...}). Data is decoded from Base64,
+    // decrypted and parsed while it is being read, so neither encrypted nor decrypted wallet is held in memory whole.
+    class LegacyWalletReader : public JsonHandler {
+        // Key of legacy wallet can only be derived with legacy parameters. Otherwise data is not decrypted.
+        const bool decrypt;
+        size_t depth = 0;
+        // Key of the current member of the root object.
+        std::string member;
+
+        Base64Decoder base64;
+        IncrementalDecryptor decryptor;
+        WalletBuilder builder;
+        JsonParser wallet_parser;
+        std::vector<unsigned char> cipher_text;
+        SecureBuffer plain_text;
+
+        // Checks if current value is a member of the root object with given key.
+        bool at(const char *name) const {
+            return depth == 1 && member == name;
+        }
+
+        void parse_plain_text() {
+            if (!json_error && !plain_text.empty()) {
+                json_error = !wallet_parser.feed(reinterpret_cast<const char *>(plain_text.data()), plain_text.size());
+            }
+            plain_text.clear();
+        }
+
+      public:
+        bool has_data = false, has_timestamp = false, has_version = false;
+        // Decrypted wallet is invalid JSON.
+        bool json_error = false;
+        // Data could not be decoded or decrypted, or it was not authentic.
+        bool decrypt_error = false;
+        uint64_t timestamp = 0;
+
+        LegacyWalletReader(const Crypto& crypto): decrypt{crypto.kdf_params() == KdfParams::legacy()},
+                                                   decryptor{crypto}, wallet_parser{builder} {}
+
+        bool decrypted() const {
+            return decrypt;
+        }
+
+        bool start_object() override {
+            ++depth;
+            return true;
+        }
+
+        bool end_object() override {
+            --depth;
+            return true;
+        }
+
+        bool start_array() override {
+            // Root must be an object.
+            if (depth == 0) return false;
+            ++depth;
+            return true;
+        }
+
+        bool end_array() override {
+            --depth;
+            return true;
+        }
+
+        bool key(const std::string& key_) override {
+            if (depth == 1) member = key_;
+            return true;
+        }
+
+        bool string_part(const char *s, size_t len) override {
+            if (depth == 0 || (at("data") && has_data)) return false;
+            if (!at("data") || !decrypt || decrypt_error) return true;
+
+            cipher_text.resize(Base64Decoder::max_output_size(len));
+            size_t cipher_text_len;
+            if (!base64.update(s, len, cipher_text.data(), cipher_text_len) ||
+                !decryptor.update(cipher_text.data(), cipher_text_len, plain_text)) {
+                decrypt_error = true;
+                return true;
+            }
+            parse_plain_text();
+            return true;
+        }
+
+        bool string_end() override {
+            if (depth == 0 || (at("data") && has_data)) return false;
+            has_version = has_version || at("version");
+            if (!at("data")) return true;
+
+            has_data = true;
+            if (!decrypt || decrypt_error) return true;
+
+            // Wallet is only valid if the tag is verified.
+            if (!base64.finish() || !decryptor.finish(plain_text)) {
+                decrypt_error = true;
+                return true;
+            }
+            parse_plain_text();
+            json_error = json_error || !wallet_parser.finish();
+            return true;
+        }
+
+        bool number(const std::string& number) override {
+            if (depth == 0) return false;
+            if (at("timestamp")) {
+                has_timestamp = true;
+                timestamp = std::strtoull(number.c_str(), NULL, 10);
+            }
+            has_version = has_version || at("version");
+            return true;
+        }
+
+        bool boolean(bool) override {
+            return depth > 0;
+        }
+
+        bool null() override {
+            return depth > 0;
+        }
+
+        // Takes decrypted wallet.
+        Wallet wallet() {
+            return builder.wallet();
+        }
+    };
+
+    Wallet load_legacy(std::istream& in, const char *prefix, size_t prefix_len, const Crypto& crypto, int& error) {
+        LegacyWalletReader reader(crypto);
+        JsonParser parser(reader);
+
+        bool parsed = parser.feed(prefix, prefix_len);
+        std::vector<char> chunk(kLegacyChunkBytes);
+        while (parsed && in.good()) {
+            in.read(chunk.data(), chunk.size());
+            parsed = parser.feed(chunk.data(), static_cast<size_t>(in.gcount()));
+        }
+        parsed = parsed && !in.bad() && parser.finish();
+
+        if (!parsed || !reader.has_data || !reader.has_timestamp || !reader.has_version) {
+            error = 2;
+            return Wallet();
+        }
+        if (!reader.decrypted()) {
+            error = 3;
+            return Wallet(reader.timestamp);
+        }
+        if (reader.decrypt_error) {
+            error = 1;
+            return Wallet(reader.timestamp);
+        }
+        if (reader.json_error) {
             error = 2;
             return Wallet();
         }
-    } catch (Json::LogicError &e) {
+
+        Wallet wallet = reader.wallet();
+        wallet.timestamp = reader.timestamp;
+        error = 0;
+        return wallet;
+    }
+
+    // Loads wallet from memory. Single message wallets are decrypted directly from it.
+    Wallet load_memory(const char *data, size_t len, const Crypto& crypto, int& error) {
+        MemoryBuffer buffer(data, len);
+        std::istream in(&buffer);
+        if (len >= kWalletMagicSize && std::memcmp(data, kWalletMagic, kWalletMagicSize) == 0) {
+            in.ignore(kWalletMagicSize);
+            return load_binary(in, data + len, crypto, error);
+        }
+
+        // Legacy JSON wallet.
+        return load_legacy(in, NULL, 0, crypto, error);
+    }
+}
+
+Wallet serialization::deserialize(const std::string& json) {
+    bool valid;
+    return deserialize_json(json.data(), json.data() + json.size(), valid);
+}
+
+std::string serialization::serialize(const Wallet& wallet) {
+    const std::vector<SortedItem> items = sorted_items(wallet);
+
+    std::string json;
+    JsonOutput<std::string> output(json, items.size() * kSerializedItemBytes + kSerializedItemBytes);
+    write_wallet(output, items);
+    return json;
+}
+
+Wallet wallet_json::read(const char *json, size_t len, bool& valid) {
+    return deserialize_json(json, json + len, valid);
+}
+
+SecureString wallet_json::write(const Wallet& wallet) {
+    const std::vector<SortedItem> items = sorted_items(wallet);
+
+    SecureString json;
+    JsonOutput<SecureString> output(json, items.size() * kSerializedItemBytes + kSerializedItemBytes);
+    write_wallet(output, items);
+    return json;
+}
+
+electronpass::Wallet serialization::load(const std::string &data, const Crypto &crypto, int &error) {
+    return load_memory(data.data(), data.size(), crypto, error);
+}
+
+bool serialization::compression_available(Compression compression) {
+    return compression == Compression::NONE || compression::available(compression);
+}
+
+std::string serialization::save(const Wallet &wallet, const Crypto &crypto, int &error, Compression compression) {
+    const Cipher cipher = crypto.cipher();
+    SecureString wallet_string;
+    uint64_t flags = 0;
+    if (!encode_payload(wallet, compression, wallet_string, flags)) {
         error = 2;
-        return Wallet();
+        return "";
     }
 
-    uint64_t timestamp = json["timestamp"].asUInt64();
+    // Large wallets are encrypted in segments on multiple threads.
+    const bool segmented = wallet_string.size() > Crypto::SEGMENT_BYTES;
+    if (segmented) flags |= kFlagSegmented;
+    Header wallet_header = new_header(wallet.timestamp, crypto.kdf_params(), static_cast<uint64_t>(cipher), flags);
 
-    bool decrypt;
-    std::string wallet_string = crypto.decrypt(json["data"].asString(), decrypt);
-    if (!decrypt) {
+    // Every save uses a new data key.
+    DerivedKey data_key = crypto.generate_data_key();
+    if (!wrap_data_key(wallet_header, crypto, data_key)) {
+        wipe(wallet_string);
         error = 1;
-        return Wallet(timestamp);
+        return "";
+    }
+    const Crypto data_crypto(data_key);
+    const std::string header = write_header(wallet_header);
+    const std::string ad = additional_data(wallet_header);
+
+    // Header is followed by raw nonce and cipher text, which are encrypted directly into the output.
+    const size_t cipher_text_len = segmented ? Crypto::segmented_cipher_text_size(wallet_string.size(), cipher)
+                                             : Crypto::cipher_text_size(wallet_string.size(), cipher);
+    std::string data(header.size() + cipher_text_len, '\0');
+    std::copy(header.begin(), header.end(), data.begin());
+
+    const unsigned char *plain_text = reinterpret_cast<const unsigned char *>(wallet_string.data());
+    unsigned char *cipher_text = reinterpret_cast<unsigned char *>(&data[header.size()]);
+    const unsigned char *raw_ad = reinterpret_cast<const unsigned char *>(ad.data());
+    bool encrypt = segmented ? data_crypto.encrypt_segmented(plain_text, wallet_string.size(), cipher_text,
+                                                             cipher_text_len, raw_ad, ad.size(), cipher)
+                             : data_crypto.encrypt(plain_text, wallet_string.size(), cipher_text, cipher_text_len,
+                                                   raw_ad, ad.size(), cipher);
+    wipe(wallet_string);
+    if (!encrypt) {
+        error = 1;
+        return "";
     }
 
-    Wallet wallet = deserialize(wallet_string);
-    wallet.timestamp = timestamp;
     error = 0;
-    return wallet;
+    return data;
 }
 
-std::string serialization::save(const Wallet &wallet, const Crypto &crypto, int &error) {
-    bool encrypt;
-    std::string data = crypto.encrypt(serialize(wallet), encrypt);
-    if (!encrypt) {
+std::string serialization::change_password(const std::string &data, const Crypto &old_crypto,
+                                           const Crypto &new_crypto, int &error) {
+    // Legacy JSON wallets are encrypted with the password key, so they have to be encrypted again.
+    if (data.compare(0, kWalletMagicSize, kWalletMagic) != 0) {
+        Wallet wallet = load(data, old_crypto, error);
+        if (error != 0) return "";
+        return save(wallet, new_crypto, error);
+    }
+
+    Header header;
+    MemoryBuffer buffer(data);
+    std::istream in(&buffer);
+    in.ignore(kWalletMagicSize);
+    error = read_header(in, header);
+    if (error != 0) return "";
+
+    error = check_crypto(header, old_crypto);
+    if (error != 0) return "";
+
+    DerivedKey data_key = unwrap_data_key(header, old_crypto);
+    if (!data_key.check()) {
+        error = 1;
+        return "";
+    }
+
+    // Only the header changes, encrypted wallet is copied as it is.
+    const size_t body_offset = write_header(header).size();
+    header.kdf = new_crypto.kdf_params();
+    if (!wrap_data_key(header, new_crypto, data_key)) {
         error = 1;
-        return "{}";
+        return "";
     }
 
     error = 0;
+    return write_header(header) + data.substr(body_offset);
+}
 
-    Json::Value json;
-    json["timestamp"] = wallet.timestamp;
-    json["version"] = kWalletVersion;
-    json["data"] = data;
+KdfParams serialization::kdf_params(const std::string &data, int &error) {
+    error = 0;
+    if (data.compare(0, kWalletMagicSize, kWalletMagic) != 0) return KdfParams::legacy();
 
-    Json::StreamWriterBuilder builder;
-    builder.settings_["indentation"] = "";
-    return Json::writeString(builder, json);
+    MemoryBuffer buffer(data);
+    std::istream in(&buffer);
+    in.ignore(kWalletMagicSize);
+
+    Header header;
+    error = read_header(in, header);
+    return error == 0 ? header.kdf : KdfParams::legacy();
+}
+
+electronpass::Wallet serialization::load(std::istream &in, const Crypto &crypto, int &error) {
+    char magic[kWalletMagicSize];
+    in.read(magic, kWalletMagicSize);
+    if (in.gcount() != kWalletMagicSize || std::memcmp(magic, kWalletMagic, kWalletMagicSize) != 0) {
+        // Legacy JSON wallet, which is decrypted while it is being read.
+        return load_legacy(in, magic, static_cast<size_t>(in.gcount()), crypto, error);
+    }
+
+    return load_binary(in, NULL, crypto, error);
+}
+
+void serialization::save(const Wallet &wallet, const Crypto &crypto, std::ostream &out, int &error,
+                         Compression compression) {
+    // Compression is recorded in the header, so payload is encoded before header is written.
+    SecureString wallet_string;
+    uint64_t flags = 0;
+    if (!encode_payload(wallet, compression, wallet_string, flags)) {
+        error = 2;
+        return;
+    }
+
+    Header wallet_header = new_header(wallet.timestamp, crypto.kdf_params(), kCipherSecretStream, flags);
+    DerivedKey data_key = crypto.generate_data_key();
+    if (!wrap_data_key(wallet_header, crypto, data_key)) {
+        wipe(wallet_string);
+        error = 1;
+        return;
+    }
+
+    const std::string header = write_header(wallet_header);
+    out.write(header.data(), header.size());
+
+    MemoryBuffer buffer(wallet_string.data(), wallet_string.size());
+    std::istream in(&buffer);
+    error = Crypto(data_key).encrypt_stream(in, out, additional_data(wallet_header)) ? 0 : 1;
+    wipe(wallet_string);
+}
+
+electronpass::Wallet serialization::load_file(const std::string &path, const Crypto &crypto, int &error) {
+    std::string data;
+    if (!file_io::read_file(path, data)) {
+        error = 5;
+        return Wallet();
+    }
+    return load_memory(data.data(), data.size(), crypto, error);
+}
+
+void serialization::save_file(const Wallet &wallet, const Crypto &crypto, const std::string &path, int &error,
+                              Compression compression) {
+    const std::string data = save(wallet, crypto, error, compression);
+    if (error != 0) return;
+    if (!file_io::write_atomic(path, data.data(), data.size())) error = 5;
 }
 
 std::string serialization::csv_export(const Wallet &wallet) {
     std::string result = "";
-    for (std::string id : wallet.get_ids()) {
-        Wallet::Item item = wallet[id];
+    for (const SortedItem& sorted_item : sorted_items(wallet)) {
+        const Wallet::Item& item = *sorted_item.item;
         result += item.name;
-        for (Wallet::Field field : item.fields) result += "," + field.name + "," + field.value;
+        for (const Wallet::Field& field : item.fields) {
+            result += "," + field.name + ",";
+            result.append(field.value.data(), field.value.size());
+        }
         result += "\n";
     }
 
@@ -0,0 +1,181 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sharing.hpp"
+#include "serialization.hpp"
+#include "wallet_json.hpp"
+
+// Version of shared data.
+#define kSharingVersion 2
+
+#define kSharingMagic "EPSH"
+#define kSharingMagicSize 4
+
+// Magic bytes, version, cipher and number of recipients.
+#define kSharingHeaderSize (kSharingMagicSize + 1 + 1 + 4)
+
+// Recipient's sealed key is found by the first bytes of BLAKE2b hash of the public key, so the recipient doesn't
+// have to try to open all of them.
+#define kKeyIdBytes 8
+#define kRecipientBytes (kKeyIdBytes + electronpass::Crypto::SEALED_KEY_BYTES)
+
+using namespace electronpass;
+
+namespace {
+    std::string key_id(const std::string& public_key) {
+        unsigned char hash[kKeyIdBytes];
+        crypto_generichash(hash, sizeof hash, reinterpret_cast<const unsigned char *>(public_key.data()),
+                           public_key.size(), NULL, 0);
+        return std::string(hash, hash + sizeof hash);
+    }
+
+    // Opens content key, sealed for this key pair. Returns invalid key if there is none.
+    DerivedKey open_content_key(const std::string& data, uint64_t count, const std::string& public_key,
+                                const DerivedKey& secret_key) {
+        const std::string id = key_id(public_key);
+        const unsigned char *raw = reinterpret_cast<const unsigned char *>(data.data());
+        const unsigned char *raw_public_key = reinterpret_cast<const unsigned char *>(public_key.data());
+
+        for (uint64_t i = 0; i < count; ++i) {
+            const size_t offset = kSharingHeaderSize + i * kRecipientBytes;
+            if (data.compare(offset, kKeyIdBytes, id) != 0) continue;
+
+            DerivedKey content_key = Crypto::open_sealed_key(raw + offset + kKeyIdBytes, Crypto::SEALED_KEY_BYTES,
+                                                             raw_public_key, secret_key);
+            if (content_key.check()) return content_key;
+        }
+        return Crypto::open_sealed_key(NULL, 0, raw_public_key, secret_key);
+    }
+}
+
+std::string sharing::share(const std::vector<Wallet::Item> &items, const std::vector<std::string> &public_keys,
+                           const DerivedKey &signing_key, int &error) {
+    if (public_keys.empty()) {
+        error = 2;
+        return "";
+    }
+    for (const std::string& public_key : public_keys) {
+        if (public_key.size() != Crypto::PUBLIC_KEY_BYTES) {
+            error = 2;
+            return "";
+        }
+    }
+
+    DerivedKey content_key = Crypto::generate_random_key();
+    if (!content_key.check()) {
+        error = 1;
+        return "";
+    }
+
+    // Header and sealed keys are authenticated as additional data.
+    const Cipher cipher = Cipher::XCHACHA20_POLY1305;
+    std::string data = kSharingMagic;
+    data += static_cast<char>(kSharingVersion);
+    data += static_cast<char>(cipher);
+    const uint32_t count = static_cast<uint32_t>(public_keys.size());
+    for (int i = 0; i < 4; ++i) data += static_cast<char>((count >> (8 * i)) & 0xff);
+
+    data.reserve(kSharingHeaderSize + public_keys.size() * kRecipientBytes);
+    unsigned char sealed[Crypto::SEALED_KEY_BYTES];
+    for (const std::string& public_key : public_keys) {
+        if (!Crypto::seal_key(content_key, reinterpret_cast<const unsigned char *>(public_key.data()), sealed)) {
+            error = 1;
+            return "";
+        }
+        data += key_id(public_key);
+        data.append(reinterpret_cast<const char *>(sealed), sizeof sealed);
+    }
+
+    // Items are encrypted only once. JSON is kept in SecureArena.
+    SecureString json = wallet_json::write(Wallet(std::vector<Wallet::Item>(items)));
+
+    const size_t ad_len = data.size();
+    const size_t signed_len = ad_len + Crypto::cipher_text_size(json.size(), cipher);
+    data.resize(signed_len + Crypto::SIGNATURE_BYTES);
+    const bool encrypt = Crypto(content_key).encrypt(reinterpret_cast<const unsigned char *>(json.data()),
+                                                     json.size(), reinterpret_cast<unsigned char *>(&data[ad_len]),
+                                                     signed_len - ad_len,
+                                                     reinterpret_cast<const unsigned char *>(data.data()), ad_len,
+                                                     cipher);
+    wipe(json);
+    if (!encrypt || !Crypto::sign(reinterpret_cast<const unsigned char *>(data.data()), signed_len, signing_key,
+                                  reinterpret_cast<unsigned char *>(&data[signed_len]))) {
+        error = 1;
+        return "";
+    }
+
+    error = 0;
+    return data;
+}
+
+electronpass::Wallet sharing::receive(const std::string &data, const std::string &public_key,
+                                      const DerivedKey &secret_key, const std::string &sender_public_key,
+                                      int &error) {
+    if (data.size() < kSharingHeaderSize || data.compare(0, kSharingMagicSize, kSharingMagic) != 0 ||
+        public_key.size() != Crypto::PUBLIC_KEY_BYTES ||
+        sender_public_key.size() != Crypto::SIGNING_PUBLIC_KEY_BYTES) {
+        error = 2;
+        return Wallet();
+    }
+
+    const unsigned char *raw = reinterpret_cast<const unsigned char *>(data.data());
+    const Cipher cipher = static_cast<Cipher>(raw[kSharingMagicSize + 1]);
+    if (raw[kSharingMagicSize] != kSharingVersion || cipher != Cipher::XCHACHA20_POLY1305) {
+        error = 2;
+        return Wallet();
+    }
+
+    uint64_t count = 0;
+    for (int i = 0; i < 4; ++i) count |= static_cast<uint64_t>(raw[kSharingMagicSize + 2 + i]) << (8 * i);
+    const uint64_t ad_len = kSharingHeaderSize + count * kRecipientBytes;
+    if (data.size() < ad_len + Crypto::cipher_text_size(0, cipher) + Crypto::SIGNATURE_BYTES) {
+        error = 2;
+        return Wallet();
+    }
+
+    // Signature is checked first, so nothing from an unknown sender is decrypted.
+    const size_t signed_len = data.size() - Crypto::SIGNATURE_BYTES;
+    if (!Crypto::verify_signature(raw, signed_len, raw + signed_len,
+                                  reinterpret_cast<const unsigned char *>(sender_public_key.data()))) {
+        error = 3;
+        return Wallet();
+    }
+
+    DerivedKey content_key = open_content_key(data, count, public_key, secret_key);
+    if (!content_key.check()) {
+        error = 4;
+        return Wallet();
+    }
+
+    const size_t cipher_text_len = signed_len - ad_len;
+    // Decrypted items are kept in SecureArena and parsed directly from it.
+    SecureString json(Crypto::plain_text_size(cipher_text_len, cipher), '\0');
+    const bool decrypt = Crypto(content_key).decrypt(raw + ad_len, cipher_text_len,
+                                                     reinterpret_cast<unsigned char *>(&json[0]), json.size(),
+                                                     raw, ad_len, cipher);
+    if (!decrypt) {
+        error = 1;
+        return Wallet();
+    }
+
+    bool valid;
+    Wallet wallet = wallet_json::read(json.data(), json.size(), valid);
+    wipe(json);
+    error = valid ? 0 : 2;
+    return wallet;
+}
@@ -16,6 +16,7 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "wallet.hpp"
+#include <algorithm>
 
 #define kFieldTypeUsername "username"
 #define kFieldTypePassword "password"
@@ -28,6 +29,38 @@ along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace electronpass;
 
+Wallet::Field::Field(Field&& other) noexcept: name{std::move(other.name)}, value{std::move(other.value)},
+                                               field_type{other.field_type}, sensitive{other.sensitive} {
+    // Short values are copied out of other, not moved.
+    wipe(other.value);
+}
+
+Wallet::Field& Wallet::Field::operator=(const Field& other) {
+    if (this == &other) return *this;
+    name = other.name;
+    wipe(value);
+    value = other.value;
+    field_type = other.field_type;
+    sensitive = other.sensitive;
+    return *this;
+}
+
+Wallet::Field& Wallet::Field::operator=(Field&& other) noexcept {
+    if (this == &other) return *this;
+    name = std::move(other.name);
+    // Moved string can give its old buffer to other, so it is wiped before and other is wiped after.
+    wipe(value);
+    value = std::move(other.value);
+    wipe(other.value);
+    field_type = other.field_type;
+    sensitive = other.sensitive;
+    return *this;
+}
+
+Wallet::Field::~Field() {
+    wipe(value);
+}
+
 uint64_t current_timestamp() {
     auto now = std::chrono::system_clock::now();
     auto new_timestamp = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
@@ -59,28 +92,32 @@ std::string Wallet::field_type_to_string(FieldType field_type) {
 }
 
 Wallet::Item::Item(uint64_t last_edited_) {
-    id = Crypto::generate_uuid();
+    id = ItemId::generate();
     last_edited = last_edited_ ? last_edited_ : current_timestamp();
 }
 
-Wallet::Item::Item(const std::string &name_, std::string id_, uint64_t last_edited_): name{name_} {
-    id = id_ == "" ? Crypto::generate_uuid() : id_;
+Wallet::Item::Item(const std::string &name_, ItemId id_, uint64_t last_edited_): name{name_} {
+    id = id_.empty() ? ItemId::generate() : std::move(id_);
     last_edited = last_edited_ ? last_edited_ : current_timestamp();
 }
 
-Wallet::Item::Item(const std::string &name_, const std::vector<Field> &fields_, std::string id_, uint64_t last_edited_): fields {fields_},
-                                                                                                                         name{name_} {
-    id = id_ == "" ? Crypto::generate_uuid() : id_;
+Wallet::Item::Item(const std::string &name_, const std::vector<Field> &fields_, ItemId id_, uint64_t last_edited_): fields {fields_},
+                                                                                                                    name{name_} {
+    id = id_.empty() ? ItemId::generate() : std::move(id_);
     last_edited = last_edited_ ? last_edited_ : current_timestamp();
 }
 
 std::string Wallet::Item::get_id() const {
+    return id.to_string();
+}
+
+const ItemId &Wallet::Item::get_item_id() const {
     return id;
 }
 
 std::string Wallet::Item::set_id() {
-    id = Crypto::generate_uuid();
-    return id;
+    id = ItemId::generate();
+    return id.to_string();
 }
 
 unsigned long Wallet::Item::size() const {
@@ -100,45 +137,78 @@ Wallet::Wallet(uint64_t timestamp_) {
     else timestamp = timestamp_;
 }
 
-Wallet::Wallet(const std::map<std::string, Item> &items_, uint64_t timestamp_): items{items_} {
+Wallet::Wallet(const std::map<std::string, Item> &items_, uint64_t timestamp_) {
+    items.reserve(items_.size());
+    for (std::map<std::string, Item>::const_iterator it = items_.begin(); it != items_.end(); ++it) {
+        items.emplace(it->first, it->second);
+    }
+
+    if (timestamp_ == 0) update_timestamp();
+    else timestamp = timestamp_;
+}
+
+Wallet::Wallet(std::vector<Item> &&items_, uint64_t timestamp_) {
+    items.reserve(items_.size());
+    for (Item& item : items_) {
+        const ItemId& id = item.get_item_id();
+        std::unordered_map<ItemId, Item>::iterator it = items.find(id);
+        if (it == items.end()) items.emplace(id, std::move(item));
+        else it->second = std::move(item);
+    }
+    items_.clear();
+
     if (timestamp_ == 0) update_timestamp();
     else timestamp = timestamp_;
 }
 
 std::vector<std::string> Wallet::get_ids() const {
-    std::vector<std::string> ids(items.size());
-    int i = 0;
-    for (std::map<std::string, Item>::const_iterator it = items.begin(); it != items.end(); ++it) {
-        ids[i] = it->first;
-        ++i;
+    std::vector<std::string> ids;
+    ids.reserve(items.size());
+    for (std::unordered_map<ItemId, Item>::const_iterator it = items.begin(); it != items.end(); ++it) {
+        ids.push_back(it->first.to_string());
     }
 
+    std::sort(ids.begin(), ids.end());
     return ids;
 }
 
-Wallet::Item Wallet::operator[](const std::string& id) const {
+std::vector<ItemId> Wallet::get_item_ids() const {
+    std::vector<ItemId> ids;
+    ids.reserve(items.size());
+    for (std::unordered_map<ItemId, Item>::const_iterator it = items.begin(); it != items.end(); ++it) {
+        ids.push_back(it->first);
+    }
+
+    return ids;
+}
+
+Wallet::Item Wallet::operator[](const ItemId& id) const {
+    return items.at(id);
+}
+
+const Wallet::Item &Wallet::get_item(const ItemId& id) const {
     return items.at(id);
 }
 
 bool Wallet::add_item(const Item &item) {
-    std::map<std::string, Item>::iterator it = items.find(item.get_id());
-    if (it == items.end()) {
-        items[item.get_id()] = item;
-        items[item.get_id()].last_edited = current_timestamp();
+    std::pair<std::unordered_map<ItemId, Item>::iterator, bool> inserted = items.emplace(item.get_item_id(), item);
+    if (inserted.second) {
+        inserted.first->second.last_edited = current_timestamp();
         return true;
     }
     update_timestamp();
     return false;
 }
 
-void Wallet::edit_item(const std::string& id, const std::string& name, const std::vector<Field>& fields) {
-    items[id].name = name;
-    items[id].fields = fields;
-    items[id].last_edited = current_timestamp();
+void Wallet::edit_item(const ItemId& id, const std::string& name, const std::vector<Field>& fields) {
+    Item& item = items[id];
+    item.name = name;
+    item.fields = fields;
+    item.last_edited = current_timestamp();
     update_timestamp();
 }
 
-Wallet::Item Wallet::delete_item(const std::string& id) {
+Wallet::Item Wallet::delete_item(const ItemId& id) {
     Item item = items[id];
     items.erase(id);
     update_timestamp();
@@ -154,31 +224,26 @@ void Wallet::update_timestamp() {
 }
 
 Wallet Wallet::merge(const Wallet &wallet1, const Wallet &wallet2) {
-    std::vector<std::string> wallet1_ids = wallet1.get_ids();
-    std::vector<std::string> wallet2_ids = wallet2.get_ids();
-    std::set<std::string> newer_wallet, older_wallet;
-    if (wallet1.timestamp >= wallet2.timestamp) {
-        newer_wallet = std::set<std::string>(wallet1_ids.begin(), wallet1_ids.end());
-        older_wallet = std::set<std::string>(wallet2_ids.begin(), wallet2_ids.end());
-    } else {
-        newer_wallet = std::set<std::string>(wallet2_ids.begin(), wallet2_ids.end());
-        older_wallet = std::set<std::string>(wallet1_ids.begin(), wallet1_ids.end());
-    }
-
-    std::map<std::string, Wallet::Item> items;
-
-    for (std::set<std::string>::iterator it = newer_wallet.begin(); it != newer_wallet.end(); ++it) {
-        if (older_wallet.find(*it) == older_wallet.end()) {
-            electronpass::Wallet wallet = wallet1.timestamp >= wallet2.timestamp ? wallet1 : wallet2;
-            items[*it] = wallet[*it];
+    // Items, which were deleted in the newer wallet, are not kept.
+    const bool first_newer = wallet1.timestamp >= wallet2.timestamp;
+    const Wallet& newer_wallet = first_newer ? wallet1 : wallet2;
+    const Wallet& older_wallet = first_newer ? wallet2 : wallet1;
+
+    std::vector<Item> items;
+    items.reserve(newer_wallet.items.size());
+    for (std::unordered_map<ItemId, Item>::const_iterator it = newer_wallet.items.begin();
+         it != newer_wallet.items.end(); ++it) {
+        std::unordered_map<ItemId, Item>::const_iterator older = older_wallet.items.find(it->first);
+        if (older == older_wallet.items.end()) {
+            items.push_back(it->second);
             continue;
         }
 
-        Wallet::Item item1 = wallet1[*it];
-        Wallet::Item item2 = wallet2[*it];
-        items[*it] = item1.last_edited >= item2.last_edited ? item1 : item2;
+        const Item& item1 = first_newer ? it->second : older->second;
+        const Item& item2 = first_newer ? older->second : it->second;
+        items.push_back(item1.last_edited >= item2.last_edited ? item1 : item2);
     }
 
     uint64_t timestamp = wallet1.timestamp > wallet2.timestamp ? wallet1.timestamp : wallet2.timestamp;
-    return Wallet(items, timestamp);
+    return Wallet(std::move(items), timestamp);
 }
@@ -0,0 +1,39 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELECTRONPASS_WALLET_JSON_HPP
+#define ELECTRONPASS_WALLET_JSON_HPP
+
+#include "wallet.hpp"
+#include "secure_memory.hpp"
+
+// Internal access to wallet JSON of serialization::serialize() and serialization::deserialize() for plain text,
+// that must not be copied into std::string.
+
+namespace electronpass {
+    namespace wallet_json {
+        // Deserializes wallet from JSON in memory. Valid is set to false if JSON is invalid, in which case wallet is
+        // empty.
+        Wallet read(const char *json, size_t len, bool& valid);
+
+        // Serializes wallet into SecureString, the same as serialization::serialize().
+        SecureString write(const Wallet& wallet);
+    }
+}
+
+#endif // ELECTRONPASS_WALLET_JSON_HPP
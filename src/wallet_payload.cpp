@@ -0,0 +1,227 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "wallet_payload.hpp"
+#include <vector>
+#include <algorithm>
+
+#define kPayloadVersion 1
+
+// Kinds of item ids.
+#define kIdBinary 0
+#define kIdText 1
+
+// Field type is stored in the lower 7 bits, sensitive flag in the highest bit.
+#define kFieldSensitive 0x80
+#define kFieldTypeMask 0x7f
+
+// Smallest encoded item: id kind, id length, 1 byte id, timestamp, name length and number of fields.
+#define kMinItemBytes 13
+
+namespace {
+    using electronpass::Wallet;
+    using electronpass::ItemId;
+    using electronpass::SecureString;
+
+    size_t varint_size(uint64_t value) {
+        size_t size = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            ++size;
+        }
+        return size;
+    }
+
+    size_t string_size(size_t len) {
+        return varint_size(len) + len;
+    }
+
+    // Appends to a string with exact capacity, so plain text is never reallocated.
+    class Writer {
+        SecureString& output;
+
+      public:
+        Writer(SecureString& output_): output{output_} {}
+
+        void byte(unsigned int value) {
+            output.push_back(static_cast<char>(value & 0xff));
+        }
+
+        void varint(uint64_t value) {
+            while (value >= 0x80) {
+                byte(static_cast<unsigned int>(value) | 0x80);
+                value >>= 7;
+            }
+            byte(static_cast<unsigned int>(value));
+        }
+
+        void fixed64(uint64_t value) {
+            for (int i = 0; i < 8; ++i) byte(static_cast<unsigned int>(value >> (8 * i)));
+        }
+
+        void string(const void *data, size_t len) {
+            varint(len);
+            output.append(static_cast<const char *>(data), len);
+        }
+    };
+
+    // Reads from memory with bounds checks. After the first failure all reads fail.
+    class Reader {
+        const unsigned char *position, *end;
+
+      public:
+        Reader(const char *data, size_t len): position{reinterpret_cast<const unsigned char *>(data)},
+                                              end{position + len} {}
+
+        size_t remaining() const {
+            return static_cast<size_t>(end - position);
+        }
+
+        bool byte(unsigned int& value) {
+            if (position == end) return false;
+            value = *position++;
+            return true;
+        }
+
+        bool varint(uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                unsigned int b;
+                if (!byte(b)) return false;
+                value |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (!(b & 0x80)) return true;
+            }
+            return false;
+        }
+
+        bool fixed64(uint64_t& value) {
+            if (remaining() < 8) return false;
+            value = 0;
+            for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(position[i]) << (8 * i);
+            position += 8;
+            return true;
+        }
+
+        bool string(const char *&data, size_t& len) {
+            uint64_t value;
+            if (!varint(value) || value > remaining()) return false;
+            data = reinterpret_cast<const char *>(position);
+            len = static_cast<size_t>(value);
+            position += len;
+            return true;
+        }
+    };
+
+    size_t item_size(const ItemId& id, const Wallet::Item& item) {
+        size_t size = 1 + string_size(id.size()) + 8 + string_size(item.name.size()) + varint_size(item.fields.size());
+        for (const Wallet::Field& field : item.fields) {
+            size += 1 + string_size(field.name.size()) + string_size(field.value.size());
+        }
+        return size;
+    }
+
+    // Reads next item and appends it to items.
+    bool read_item(Reader& reader, std::vector<Wallet::Item>& items) {
+        unsigned int id_kind;
+        const char *id, *name;
+        size_t id_len, name_len;
+        uint64_t last_edited, field_count;
+        if (!reader.byte(id_kind) || !reader.string(id, id_len) || !reader.fixed64(last_edited) ||
+            !reader.string(name, name_len) || !reader.varint(field_count)) {
+            return false;
+        }
+
+        ItemId item_id;
+        if (id_kind == kIdBinary) item_id = ItemId::from_bytes(reinterpret_cast<const unsigned char *>(id), id_len);
+        else if (id_kind == kIdText) item_id = ItemId(id, id_len);
+        if (item_id.empty()) return false;
+
+        items.push_back(Wallet::Item("", std::move(item_id), last_edited));
+        Wallet::Item& item = items.back();
+        item.name.assign(name, name_len);
+
+        // Each field has at least 3 bytes, so count can't make fields allocate more than the data.
+        if (field_count > reader.remaining() / 3) return false;
+        item.fields.resize(static_cast<size_t>(field_count));
+        for (Wallet::Field& field : item.fields) {
+            unsigned int type;
+            const char *field_name, *value;
+            size_t field_name_len, value_len;
+            if (!reader.byte(type) || !reader.string(field_name, field_name_len) || !reader.string(value, value_len)) {
+                return false;
+            }
+
+            const unsigned int field_type = type & kFieldTypeMask;
+            field.field_type = field_type < static_cast<unsigned int>(Wallet::FieldType::UNDEFINED)
+                               ? static_cast<Wallet::FieldType>(field_type) : Wallet::FieldType::UNDEFINED;
+            field.sensitive = (type & kFieldSensitive) != 0;
+            field.name.assign(field_name, field_name_len);
+            field.value.assign(value, value_len);
+        }
+        return true;
+    }
+}
+
+electronpass::SecureString electronpass::payload::encode(const Wallet& wallet) {
+    const std::vector<ItemId> ids = wallet.get_item_ids();
+
+    size_t size = 1 + varint_size(ids.size());
+    for (const ItemId& id : ids) size += item_size(id, wallet.get_item(id));
+
+    SecureString result;
+    result.reserve(size);
+    Writer writer(result);
+    writer.byte(kPayloadVersion);
+    writer.varint(ids.size());
+    for (const ItemId& id : ids) {
+        const Wallet::Item& item = wallet.get_item(id);
+        writer.byte(id.binary() ? kIdBinary : kIdText);
+        writer.string(id.data(), id.size());
+        writer.fixed64(item.last_edited);
+        writer.string(item.name.data(), item.name.size());
+        writer.varint(item.fields.size());
+        for (const Wallet::Field& field : item.fields) {
+            writer.byte(static_cast<unsigned int>(field.field_type) | (field.sensitive ? kFieldSensitive : 0));
+            writer.string(field.name.data(), field.name.size());
+            writer.string(field.value.data(), field.value.size());
+        }
+    }
+    return result;
+}
+
+electronpass::Wallet electronpass::payload::decode(const char *data, size_t len, bool& valid) {
+    Reader reader(data, len);
+    unsigned int version;
+    uint64_t count;
+    valid = reader.byte(version) && version == kPayloadVersion && reader.varint(count) &&
+            count <= reader.remaining() / kMinItemBytes;
+    if (!valid) return Wallet();
+
+    std::vector<Wallet::Item> items;
+    items.reserve(static_cast<size_t>(count));
+    for (uint64_t i = 0; i < count; ++i) {
+        if (!read_item(reader, items)) {
+            valid = false;
+            return Wallet();
+        }
+    }
+
+    // Nothing can follow the last item.
+    valid = reader.remaining() == 0;
+    return valid ? Wallet(std::move(items)) : Wallet();
+}
@@ -0,0 +1,40 @@
+/*
+This file is part of libelectronpass.
+
+Libelectronpass is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Libelectronpass is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with libelectronpass.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELECTRONPASS_WALLET_PAYLOAD_HPP
+#define ELECTRONPASS_WALLET_PAYLOAD_HPP
+
+#include <string>
+#include "wallet.hpp"
+
+// Internal binary encoding of wallet items, which is encrypted in binary wallets instead of JSON.
+// Format is described in Data Definitions.md.
+
+namespace electronpass {
+    namespace payload {
+        // Encodes items of the wallet. Result is in secure memory, but short results can be stored inside the string
+        // object (see SecureString), so it still has to be wiped by the caller.
+        SecureString encode(const Wallet& wallet);
+
+        // Decodes items. Valid is set to false if data is not a supported payload, in which case wallet is empty.
+        // Wallet timestamp is not part of the payload.
+        Wallet decode(const char *data, size_t len, bool& valid);
+    }
+}
+
+#endif // ELECTRONPASS_WALLET_PAYLOAD_HPP
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "crypto.hpp"
 
 
@@ -104,3 +106,96 @@ TEST(Base64Decode, InvalidBase64StringLength) {
     EXPECT_EQ(electronpass::Crypto::base64_decode("ABCDEF"), "");
     EXPECT_EQ(electronpass::Crypto::base64_decode("ABCDEFG"), "");
 }
+
+TEST(Base64Decode, InvalidCharacters) {
+    // Characters outside of Base64 alphabet and padding, that is not at the end.
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VGV.dA=="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VGVzdA==VGVzdA=="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VG=zdA=="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VGVzd==="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("===="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VGVz\xc3\xa9" "A=="), "");
+
+    // Bits after the last byte must be zero.
+    EXPECT_EQ(electronpass::Crypto::base64_decode("VGVzdB=="), "");
+    EXPECT_EQ(electronpass::Crypto::base64_decode("U2FtcGxlIHRleHR="), "");
+}
+
+TEST(Base64, LongData) {
+    // Long data is encoded and decoded with vectorized code on CPUs that support it. Every length leaves a different
+    // remainder for scalar code.
+    std::string data;
+    for (size_t len = 0; len < 200; ++len) {
+        const std::string encoded = electronpass::Crypto::base64_encode(data);
+        EXPECT_EQ(encoded.size(), (len + 2) / 3 * 4);
+        EXPECT_EQ(electronpass::Crypto::base64_decode(encoded), data);
+
+        // Invalid character anywhere is detected.
+        for (size_t i = 0; i < encoded.size(); i += 7) {
+            std::string invalid = encoded;
+            invalid[i] = i % 2 ? '-' : '\x80';
+            EXPECT_EQ(electronpass::Crypto::base64_decode(invalid), "");
+        }
+
+        data += static_cast<char>(len * 97 + 13);
+    }
+
+    // All byte values are encoded correctly.
+    std::string bytes;
+    for (int i = 0; i < 256 * 3; ++i) bytes += static_cast<char>(i % 256);
+    const std::string encoded = electronpass::Crypto::base64_encode(bytes);
+    EXPECT_EQ(encoded.substr(0, 16), "AAECAwQFBgcICQoL");
+    EXPECT_EQ(electronpass::Crypto::base64_decode(encoded), bytes);
+}
+
+TEST(Base64, Streaming) {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) data += static_cast<char>(i * 31 + 7);
+    const std::string expected = electronpass::Crypto::base64_encode(data);
+
+    // Output of chunks of any size is the same as of the whole string.
+    for (size_t chunk : {1, 2, 3, 5, 16, 47, 1000}) {
+        electronpass::Base64Encoder encoder;
+        std::string encoded;
+        for (size_t i = 0; i < data.size(); i += chunk) {
+            const size_t len = std::min(chunk, data.size() - i);
+            std::string output(electronpass::Base64Encoder::max_output_size(len), '\0');
+            output.resize(encoder.update(reinterpret_cast<const unsigned char *>(&data[i]), len, &output[0]));
+            encoded += output;
+        }
+        char rest[electronpass::Base64Encoder::FINISH_BYTES];
+        encoded.append(rest, encoder.finish(rest));
+        EXPECT_EQ(encoded, expected);
+
+        electronpass::Base64Decoder decoder;
+        std::string decoded;
+        for (size_t i = 0; i < encoded.size(); i += chunk) {
+            const size_t len = std::min(chunk, encoded.size() - i);
+            std::string output(electronpass::Base64Decoder::max_output_size(len), '\0');
+            size_t output_len;
+            EXPECT_TRUE(decoder.update(&encoded[i], len, reinterpret_cast<unsigned char *>(&output[0]), output_len));
+            decoded.append(output, 0, output_len);
+        }
+        EXPECT_TRUE(decoder.finish());
+        EXPECT_EQ(decoded, data);
+    }
+
+    // Incomplete group, data after padding and invalid characters.
+    unsigned char output[16];
+    size_t output_len;
+    electronpass::Base64Decoder decoder;
+    EXPECT_TRUE(decoder.update("VGVzdA", 6, output, output_len));
+    EXPECT_EQ(output_len, 3u);
+    EXPECT_FALSE(decoder.finish());
+    EXPECT_TRUE(decoder.update("VGVzdA=", 7, output, output_len));
+    EXPECT_FALSE(decoder.update("=VGVz", 5, output, output_len));
+    EXPECT_FALSE(decoder.finish());
+    EXPECT_FALSE(decoder.update("VG.z", 4, output, output_len));
+    EXPECT_FALSE(decoder.update("VGVz", 4, output, output_len));
+    EXPECT_FALSE(decoder.finish());
+
+    // Decoder can be used again after finish().
+    EXPECT_TRUE(decoder.update("VGVzdA==", 8, output, output_len));
+    EXPECT_TRUE(decoder.finish());
+    EXPECT_EQ(std::string(output, output + output_len), "Test");
+}
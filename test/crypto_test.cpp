@@ -3,6 +3,15 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 
 #include "crypto.hpp"
@@ -129,3 +138,584 @@ TEST(CryptoTest, UniqueIDTest) {
     for (unsigned long i = 0; i < size; ++i) generated_ids.insert(electronpass::Crypto::generate_uuid());
     EXPECT_EQ(size, generated_ids.size());
 }
+
+TEST(CryptoTest, BufferEncryptionDecryptionTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    const std::string text = random_string(1000);
+    const size_t size = electronpass::Crypto::cipher_text_size(text.size());
+    EXPECT_EQ(size, text.size() + electronpass::Crypto::OVERHEAD_BYTES);
+    EXPECT_EQ(electronpass::Crypto::plain_text_size(size), text.size());
+
+    // Encrypt in place.
+    std::vector<unsigned char> buffer(size);
+    unsigned char *plain = buffer.data() + electronpass::Crypto::NONCE_BYTES;
+    std::copy(text.begin(), text.end(), plain);
+    ASSERT_TRUE(c.encrypt(plain, text.size(), buffer.data(), buffer.size()));
+    EXPECT_NE(std::string(plain, plain + text.size()), text);
+
+    // Raw cipher text is the same as Base64 decoded output of string encryption.
+    bool ok = false;
+    EXPECT_EQ(c.decrypt(electronpass::Crypto::base64_encode(std::string(buffer.begin(), buffer.end())), ok), text);
+    EXPECT_TRUE(ok);
+
+    // Decrypt in place.
+    ASSERT_TRUE(c.decrypt(buffer.data(), buffer.size(), plain, text.size()));
+    EXPECT_EQ(std::string(plain, plain + text.size()), text);
+
+    // Wrong output size.
+    std::vector<unsigned char> out(text.size() + 1);
+    EXPECT_FALSE(c.encrypt(out.data(), text.size(), buffer.data(), buffer.size() - 1));
+    EXPECT_FALSE(c.decrypt(buffer.data(), buffer.size(), out.data(), out.size()));
+    EXPECT_FALSE(c.decrypt(buffer.data(), electronpass::Crypto::OVERHEAD_BYTES - 1, out.data(), 0));
+}
+
+TEST(CryptoTest, CipherTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    EXPECT_TRUE(electronpass::Crypto::cipher_available(electronpass::Cipher::CHACHA20_POLY1305));
+    EXPECT_TRUE(electronpass::Crypto::cipher_available(electronpass::Cipher::XCHACHA20_POLY1305));
+    EXPECT_TRUE(electronpass::Crypto::cipher_available(electronpass::Crypto::preferred_cipher()));
+    EXPECT_EQ(c.cipher(), electronpass::Cipher::XCHACHA20_POLY1305);
+
+    EXPECT_TRUE(c.set_cipher(electronpass::Cipher::XCHACHA20_POLY1305));
+    EXPECT_EQ(c.cipher(), electronpass::Cipher::XCHACHA20_POLY1305);
+    const bool aes = electronpass::Crypto::cipher_available(electronpass::Cipher::AES256_GCM);
+    EXPECT_EQ(c.set_cipher(electronpass::Cipher::AES256_GCM), aes);
+    EXPECT_EQ(c.cipher(), aes ? electronpass::Cipher::AES256_GCM : electronpass::Cipher::XCHACHA20_POLY1305);
+    EXPECT_EQ(electronpass::Crypto::preferred_cipher(),
+              aes ? electronpass::Cipher::AES256_GCM : electronpass::Cipher::XCHACHA20_POLY1305);
+
+    const electronpass::Cipher ciphers[] = {electronpass::Cipher::CHACHA20_POLY1305,
+                                            electronpass::Cipher::XCHACHA20_POLY1305,
+                                            electronpass::Cipher::AES256_GCM};
+    const std::string text = random_string(1000);
+    const std::string ad = "additional data";
+    const unsigned char *ad_data = reinterpret_cast<const unsigned char *>(ad.data());
+    for (electronpass::Cipher cipher : ciphers) {
+        if (!electronpass::Crypto::cipher_available(cipher)) continue;
+
+        const size_t nonce_size = electronpass::Crypto::nonce_size(cipher);
+        const size_t size = electronpass::Crypto::cipher_text_size(text.size(), cipher);
+        EXPECT_EQ(size, nonce_size + text.size() + 16);
+        EXPECT_EQ(electronpass::Crypto::plain_text_size(size, cipher), text.size());
+
+        // Encrypt and decrypt in place.
+        std::vector<unsigned char> buffer(size);
+        unsigned char *plain = buffer.data() + nonce_size;
+        std::copy(text.begin(), text.end(), plain);
+        ASSERT_TRUE(c.encrypt(plain, text.size(), buffer.data(), buffer.size(), ad_data, ad.size(), cipher));
+        EXPECT_NE(std::string(plain, plain + text.size()), text);
+
+        std::vector<unsigned char> copy = buffer;
+        ASSERT_TRUE(c.decrypt(buffer.data(), buffer.size(), plain, text.size(), ad_data, ad.size(), cipher));
+        EXPECT_EQ(std::string(plain, plain + text.size()), text);
+
+        // Wrong additional data or tampered cipher text.
+        std::vector<unsigned char> out(text.size());
+        EXPECT_FALSE(c.decrypt(copy.data(), copy.size(), out.data(), out.size(), ad_data, ad.size() - 1, cipher));
+        copy[nonce_size] ^= 1;
+        EXPECT_FALSE(c.decrypt(copy.data(), copy.size(), out.data(), out.size(), ad_data, ad.size(), cipher));
+    }
+}
+
+TEST(CryptoTest, EncryptDecryptManyTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    std::vector<std::string> texts;
+    for (int i = 0; i < 200; ++i) texts.push_back(random_string(i * 7 % 300));
+
+    for (unsigned int threads : {1u, 4u, 0u}) {
+        bool ok = false;
+        std::vector<std::string> encrypted = c.encrypt_many(texts, ok, threads);
+        ASSERT_TRUE(ok);
+        ASSERT_EQ(encrypted.size(), texts.size());
+
+        // Messages can also be decrypted one by one.
+        EXPECT_EQ(c.decrypt(encrypted[10], ok), texts[10]);
+        EXPECT_TRUE(ok);
+        electronpass::SecureString plain_text;
+        EXPECT_TRUE(c.decrypt(encrypted[11], plain_text));
+        EXPECT_EQ(std::string(plain_text.data(), plain_text.size()), texts[11]);
+        std::string cipher_text;
+        EXPECT_TRUE(c.encrypt(plain_text, cipher_text));
+        EXPECT_EQ(c.decrypt(cipher_text, ok), texts[11]);
+        EXPECT_FALSE(c.decrypt(cipher_text.substr(0, 8), plain_text));
+        EXPECT_TRUE(plain_text.empty());
+
+        encrypted[3] = encrypted[4];
+        encrypted[5][0] = encrypted[5][0] == 'a' ? 'b' : 'a';
+        std::vector<bool> success;
+        electronpass::SecureStringVector decrypted = c.decrypt_many(encrypted, success, threads);
+        ASSERT_EQ(decrypted.size(), texts.size());
+        ASSERT_EQ(success.size(), texts.size());
+        for (size_t i = 0; i < texts.size(); ++i) {
+            if (i == 5) {
+                EXPECT_FALSE(success[i]);
+                EXPECT_TRUE(decrypted[i].empty());
+            } else {
+                EXPECT_TRUE(success[i]);
+                EXPECT_EQ(std::string(decrypted[i].data(), decrypted[i].size()), i == 3 ? texts[4] : texts[i]);
+            }
+        }
+    }
+
+    bool ok = false;
+    EXPECT_TRUE(c.encrypt_many(std::vector<std::string>(), ok, 4).empty());
+    EXPECT_TRUE(ok);
+}
+
+TEST(CryptoTest, SegmentedEncryptionDecryptionTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    const size_t segment = electronpass::Crypto::SEGMENT_BYTES;
+    const electronpass::Cipher cipher = electronpass::Cipher::XCHACHA20_POLY1305;
+    const size_t tag = 16;
+    const size_t nonce = electronpass::Crypto::nonce_size(cipher);
+    const std::string ad = "header";
+    const unsigned char *ad_data = reinterpret_cast<const unsigned char *>(ad.data());
+
+    for (size_t size : {size_t(0), size_t(1), segment, segment + 1, 3 * segment + 5}) {
+        const std::string text = random_string(size);
+        const size_t cipher_size = electronpass::Crypto::segmented_cipher_text_size(size, cipher);
+        EXPECT_EQ(electronpass::Crypto::segmented_plain_text_size(cipher_size, cipher), size);
+
+        std::vector<unsigned char> encrypted(cipher_size);
+        ASSERT_TRUE(c.encrypt_segmented(reinterpret_cast<const unsigned char *>(text.data()), size,
+                                        encrypted.data(), encrypted.size(), ad_data, ad.size(), cipher, 4));
+
+        // Number of threads doesn't affect the result.
+        std::vector<unsigned char> decrypted(size);
+        ASSERT_TRUE(c.decrypt_segmented(encrypted.data(), encrypted.size(), decrypted.data(), size,
+                                        ad_data, ad.size(), cipher, 1));
+        EXPECT_EQ(std::string(decrypted.begin(), decrypted.end()), text);
+
+        EXPECT_FALSE(c.decrypt_segmented(encrypted.data(), encrypted.size(), decrypted.data(), size,
+                                         ad_data, ad.size() - 1, cipher));
+    }
+
+    const std::string text = random_string(3 * segment);
+    std::vector<unsigned char> encrypted(electronpass::Crypto::segmented_cipher_text_size(text.size(), cipher));
+    ASSERT_TRUE(c.encrypt_segmented(reinterpret_cast<const unsigned char *>(text.data()), text.size(),
+                                    encrypted.data(), encrypted.size(), NULL, 0, cipher));
+
+    // Removing the last segment.
+    std::vector<unsigned char> decrypted(2 * segment);
+    EXPECT_EQ(electronpass::Crypto::segmented_plain_text_size(encrypted.size() - segment - tag, cipher), 2 * segment);
+    EXPECT_FALSE(c.decrypt_segmented(encrypted.data(), encrypted.size() - segment - tag,
+                                     decrypted.data(), decrypted.size(), NULL, 0, cipher));
+
+    // Swapping two segments.
+    std::vector<unsigned char> swapped = encrypted;
+    std::swap_ranges(swapped.begin() + nonce, swapped.begin() + nonce + segment + tag,
+                     swapped.begin() + nonce + segment + tag);
+    decrypted.resize(text.size());
+    EXPECT_FALSE(c.decrypt_segmented(swapped.data(), swapped.size(), decrypted.data(), decrypted.size(),
+                                     NULL, 0, cipher));
+    EXPECT_EQ(std::count(decrypted.begin(), decrypted.end(), 0), static_cast<long>(decrypted.size()));
+
+    // Cipher text length, that can't be produced by encryption.
+    EXPECT_EQ(electronpass::Crypto::segmented_plain_text_size(nonce + segment + tag + 3, cipher), 0u);
+}
+
+TEST(CryptoTest, StreamEncryptionDecryptionTest) {
+    electronpass::Crypto c1("password");
+    electronpass::Crypto c2("Password");
+    ASSERT_TRUE(c1.check() && c2.check());
+
+    const size_t chunk = electronpass::Crypto::STREAM_CHUNK_BYTES;
+    const std::vector<size_t> sizes = {0, 1, 100, chunk - 1, chunk, chunk + 1, 3 * chunk + 17};
+    for (size_t size : sizes) {
+        const std::string text = random_string(static_cast<int>(size));
+
+        std::istringstream plain_in(text);
+        std::ostringstream cipher_out;
+        ASSERT_TRUE(c1.encrypt_stream(plain_in, cipher_out));
+        const std::string cipher = cipher_out.str();
+
+        std::istringstream cipher_in(cipher);
+        std::ostringstream plain_out;
+        EXPECT_TRUE(c1.decrypt_stream(cipher_in, plain_out));
+        EXPECT_EQ(plain_out.str(), text);
+
+        // Wrong password.
+        std::istringstream cipher_in2(cipher);
+        std::ostringstream plain_out2;
+        EXPECT_FALSE(c2.decrypt_stream(cipher_in2, plain_out2));
+
+        // Truncated at chunk boundary and in the middle of a chunk.
+        if (size > chunk) {
+            std::istringstream truncated(cipher.substr(0, 24 + chunk + 17));
+            std::ostringstream out;
+            EXPECT_FALSE(c1.decrypt_stream(truncated, out));
+        }
+        std::istringstream truncated(cipher.substr(0, cipher.size() - 1));
+        std::ostringstream out;
+        EXPECT_FALSE(c1.decrypt_stream(truncated, out));
+
+        // Trailing data.
+        std::istringstream extended(cipher + "x");
+        std::ostringstream out2;
+        EXPECT_FALSE(c1.decrypt_stream(extended, out2));
+    }
+}
+
+TEST(CryptoTest, DerivedKeyTest) {
+    electronpass::DerivedKey key = electronpass::Crypto::derive_key("password");
+    ASSERT_TRUE(key.check());
+
+    electronpass::Crypto c1(key);
+    electronpass::Crypto c2("password");
+    ASSERT_TRUE(c1.check() && c2.check());
+
+    // Key is the same as the one generated from password.
+    bool ok = false;
+    EXPECT_EQ(c2.decrypt(c1.encrypt("Hello, World!", ok), ok), "Hello, World!");
+    EXPECT_TRUE(ok);
+
+    // Many Crypto objects can be created from the same key.
+    for (int i = 0; i < 100; ++i) {
+        electronpass::Crypto c(key);
+        EXPECT_EQ(c.decrypt(c2.encrypt("Hello, World!", ok), ok), "Hello, World!");
+        EXPECT_TRUE(ok);
+    }
+
+    electronpass::DerivedKey moved = std::move(key);
+    EXPECT_TRUE(moved.check());
+    EXPECT_FALSE(key.check());
+    EXPECT_FALSE(electronpass::Crypto(key).check());
+
+    key = electronpass::Crypto::derive_key("Password");
+    EXPECT_TRUE(key.check());
+    EXPECT_EQ(electronpass::Crypto(key).decrypt(c1.encrypt("Hello, World!", ok), ok), "");
+    EXPECT_FALSE(ok);
+}
+
+TEST(CryptoTest, DataKeyTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    electronpass::DerivedKey data_key = c.generate_data_key();
+    ASSERT_TRUE(data_key.check());
+    // Data key is random, it was not derived with the password's parameters.
+    EXPECT_FALSE(data_key.kdf_params() == c.kdf_params());
+    EXPECT_FALSE(data_key.kdf_params().valid());
+    EXPECT_FALSE(electronpass::Crypto(data_key).kdf_params().valid());
+
+    const std::string ad = "header";
+    const unsigned char *ad_data = reinterpret_cast<const unsigned char *>(ad.data());
+    std::vector<unsigned char> wrapped(electronpass::Crypto::WRAPPED_KEY_BYTES);
+    ASSERT_TRUE(c.wrap_key(data_key, wrapped.data(), ad_data, ad.size()));
+
+    // Unwrapped key is the same as the original one.
+    electronpass::DerivedKey unwrapped = c.unwrap_key(wrapped.data(), wrapped.size(), ad_data, ad.size());
+    ASSERT_TRUE(unwrapped.check());
+    bool ok = false;
+    EXPECT_EQ(electronpass::Crypto(unwrapped).decrypt(electronpass::Crypto(data_key).encrypt("Hello", ok), ok),
+              "Hello");
+    EXPECT_TRUE(ok);
+
+    // Data keys are random.
+    EXPECT_EQ(electronpass::Crypto(c.generate_data_key()).decrypt(electronpass::Crypto(data_key).encrypt("Hello", ok),
+                                                                  ok), "");
+    EXPECT_FALSE(ok);
+
+    // Wrong password, additional data or length.
+    EXPECT_FALSE(electronpass::Crypto("Password").unwrap_key(wrapped.data(), wrapped.size(), ad_data, ad.size()).check());
+    EXPECT_FALSE(c.unwrap_key(wrapped.data(), wrapped.size()).check());
+    EXPECT_FALSE(c.unwrap_key(wrapped.data(), wrapped.size() - 1, ad_data, ad.size()).check());
+
+    electronpass::DerivedKey moved = std::move(data_key);
+    EXPECT_FALSE(c.wrap_key(data_key, wrapped.data()));
+}
+
+TEST(CryptoTest, SealedKeyTest) {
+    unsigned char public_key[electronpass::Crypto::PUBLIC_KEY_BYTES];
+    electronpass::DerivedKey secret_key = electronpass::Crypto::generate_key_pair(public_key);
+    ASSERT_TRUE(secret_key.check());
+    unsigned char other_public_key[electronpass::Crypto::PUBLIC_KEY_BYTES];
+    electronpass::DerivedKey other_secret_key = electronpass::Crypto::generate_key_pair(other_public_key);
+
+    electronpass::DerivedKey data_key = electronpass::Crypto::generate_random_key();
+    ASSERT_TRUE(data_key.check());
+    unsigned char sealed[electronpass::Crypto::SEALED_KEY_BYTES];
+    ASSERT_TRUE(electronpass::Crypto::seal_key(data_key, public_key, sealed));
+
+    // Opened key encrypts the same as the original.
+    electronpass::DerivedKey opened = electronpass::Crypto::open_sealed_key(sealed, sizeof sealed, public_key,
+                                                                            secret_key);
+    ASSERT_TRUE(opened.check());
+    bool success;
+    const std::string cipher_text = electronpass::Crypto(data_key).encrypt("shared", success);
+    EXPECT_EQ(electronpass::Crypto(opened).decrypt(cipher_text, success), "shared");
+    EXPECT_TRUE(success);
+
+    // Other key pair, changed key and wrong size.
+    EXPECT_FALSE(electronpass::Crypto::open_sealed_key(sealed, sizeof sealed, other_public_key,
+                                                       other_secret_key).check());
+    sealed[40] ^= 1;
+    EXPECT_FALSE(electronpass::Crypto::open_sealed_key(sealed, sizeof sealed, public_key, secret_key).check());
+    EXPECT_FALSE(electronpass::Crypto::open_sealed_key(sealed, sizeof sealed - 1, public_key, secret_key).check());
+
+    // Secret key can be stored in a wallet like a data key.
+    electronpass::Crypto crypto("password");
+    unsigned char wrapped[electronpass::Crypto::WRAPPED_KEY_BYTES];
+    ASSERT_TRUE(crypto.wrap_key(secret_key, wrapped));
+    electronpass::DerivedKey unwrapped = crypto.unwrap_key(wrapped, sizeof wrapped);
+    ASSERT_TRUE(electronpass::Crypto::seal_key(data_key, public_key, sealed));
+    EXPECT_TRUE(electronpass::Crypto::open_sealed_key(sealed, sizeof sealed, public_key, unwrapped).check());
+}
+
+TEST(CryptoTest, KeyCheckTest) {
+    electronpass::Crypto c("password");
+    ASSERT_TRUE(c.check());
+
+    const std::string key_check = c.key_check();
+    EXPECT_EQ(key_check.size(), electronpass::Crypto::KEY_CHECK_BYTES);
+    EXPECT_EQ(electronpass::Crypto(electronpass::Crypto::derive_key("password")).key_check(), key_check);
+    EXPECT_TRUE(c.verify_key_check(key_check));
+
+    EXPECT_FALSE(electronpass::Crypto("Password").verify_key_check(key_check));
+    EXPECT_FALSE(c.verify_key_check(key_check.substr(1)));
+    EXPECT_FALSE(c.verify_key_check(""));
+}
+
+TEST(CryptoTest, IncrementalDecryptorTest) {
+    electronpass::Crypto crypto("password");
+    std::string plain_text(100000, '\0');
+    for (size_t i = 0; i < plain_text.size(); ++i) plain_text[i] = static_cast<char>(i * 7);
+
+    bool success;
+    const std::string cipher_text = electronpass::Crypto::base64_decode(crypto.encrypt(plain_text, success));
+    ASSERT_TRUE(success);
+    const unsigned char *raw = reinterpret_cast<const unsigned char *>(cipher_text.data());
+
+    // Chunks of different sizes, that don't line up with blocks.
+    for (size_t chunk : {1, 7, 64, 65, 1000, 100024}) {
+        electronpass::IncrementalDecryptor decryptor(crypto);
+        electronpass::SecureBuffer output;
+        for (size_t i = 0; i < cipher_text.size(); i += chunk) {
+            EXPECT_TRUE(decryptor.update(raw + i, std::min(chunk, cipher_text.size() - i), output));
+        }
+        EXPECT_TRUE(decryptor.finish(output));
+        EXPECT_EQ(std::string(output.begin(), output.end()), plain_text);
+    }
+
+    // Changed data, truncated data and wrong key.
+    std::string changed = cipher_text;
+    changed[5000] ^= 1;
+    electronpass::SecureBuffer output;
+    electronpass::IncrementalDecryptor decryptor1(crypto);
+    decryptor1.update(reinterpret_cast<const unsigned char *>(changed.data()), changed.size(), output);
+    EXPECT_FALSE(decryptor1.finish(output));
+
+    electronpass::IncrementalDecryptor decryptor2(crypto);
+    decryptor2.update(raw, cipher_text.size() - 1, output);
+    EXPECT_FALSE(decryptor2.finish(output));
+
+    electronpass::IncrementalDecryptor decryptor3(electronpass::Crypto("Password"));
+    decryptor3.update(raw, cipher_text.size(), output);
+    EXPECT_FALSE(decryptor3.finish(output));
+
+    // Empty message.
+    const std::string empty = electronpass::Crypto::base64_decode(crypto.encrypt("", success));
+    electronpass::IncrementalDecryptor decryptor4(crypto);
+    output.clear();
+    decryptor4.update(reinterpret_cast<const unsigned char *>(empty.data()), empty.size(), output);
+    EXPECT_TRUE(decryptor4.finish(output));
+    EXPECT_TRUE(output.empty());
+}
+
+TEST(CryptoTest, AsyncKeyDerivationTest) {
+    electronpass::KeyDerivation derivation = electronpass::Crypto::derive_async("password");
+    derivation.wait();
+    EXPECT_TRUE(derivation.ready());
+    EXPECT_FALSE(derivation.is_cancelled());
+
+    electronpass::DerivedKey key = derivation.get();
+    ASSERT_TRUE(key.check());
+    // Key can be taken only once.
+    EXPECT_FALSE(derivation.get().check());
+
+    bool ok = false;
+    electronpass::Crypto c("password");
+    EXPECT_EQ(electronpass::Crypto(key).decrypt(c.encrypt("Hello, World!", ok), ok), "Hello, World!");
+    EXPECT_TRUE(ok);
+
+    // Callback.
+    std::promise<bool> called;
+    electronpass::KeyDerivation derivation2 = electronpass::Crypto::derive_async("password",
+        [&called](electronpass::DerivedKey derived) {
+            called.set_value(derived.check());
+        });
+    EXPECT_TRUE(called.get_future().get());
+    derivation2.wait();
+    EXPECT_FALSE(derivation2.get().check());
+
+    // Cancelled derivation doesn't deliver the key.
+    bool cancelled_called = false;
+    electronpass::KeyDerivation derivation3 = electronpass::Crypto::derive_async("password",
+        [&cancelled_called](electronpass::DerivedKey) {
+            cancelled_called = true;
+        });
+    derivation3.cancel();
+    EXPECT_TRUE(derivation3.is_cancelled());
+    derivation3.wait();
+    EXPECT_FALSE(cancelled_called);
+    EXPECT_FALSE(derivation3.get().check());
+}
+
+TEST(CryptoTest, AsyncKeyDerivationSupersedeTest) {
+    // First derivation holds the worker in its callback, so the following ones have to wait.
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    electronpass::KeyDerivation running = electronpass::Crypto::derive_async("password",
+        [&started, released](electronpass::DerivedKey) {
+            started.set_value();
+            released.wait();
+        });
+    started.get_future().wait();
+
+    electronpass::KeyDerivation outdated = electronpass::Crypto::derive_async("passwor");
+    electronpass::KeyDerivation latest = electronpass::Crypto::derive_async("password");
+
+    // Waiting derivation is dropped as soon as a newer one comes, without being started.
+    EXPECT_TRUE(outdated.ready());
+    EXPECT_TRUE(outdated.is_cancelled());
+    EXPECT_FALSE(outdated.get().check());
+    EXPECT_FALSE(latest.ready());
+
+    release.set_value();
+    running.wait();
+    electronpass::DerivedKey key = latest.get();
+    EXPECT_FALSE(latest.is_cancelled());
+    ASSERT_TRUE(key.check());
+
+    bool ok = false;
+    electronpass::Crypto c("password");
+    EXPECT_EQ(electronpass::Crypto(key).decrypt(c.encrypt("Hello, World!", ok), ok), "Hello, World!");
+    EXPECT_TRUE(ok);
+}
+
+TEST(CryptoTest, QuickUnlockTest) {
+    electronpass::DerivedKey key = electronpass::Crypto::derive_key("password");
+    ASSERT_TRUE(key.check());
+    electronpass::Crypto c(key);
+    bool ok = false;
+    const std::string encrypted = c.encrypt("Hello, World!", ok);
+
+    electronpass::QuickUnlock session(key, "1234");
+    EXPECT_TRUE(session.active());
+    EXPECT_TRUE(session.lock_if_expired());
+    EXPECT_EQ(session.attempts_left(), 3u);
+
+    electronpass::DerivedKey unlocked = session.unlock("1234");
+    ASSERT_TRUE(unlocked.check());
+    EXPECT_TRUE(unlocked.kdf_params() == key.kdf_params());
+    EXPECT_EQ(electronpass::Crypto(unlocked).decrypt(encrypted, ok), "Hello, World!");
+    EXPECT_TRUE(ok);
+
+    // Successful unlock resets attempts.
+    EXPECT_FALSE(session.unlock("0000").check());
+    EXPECT_EQ(session.attempts_left(), 2u);
+    EXPECT_TRUE(session.unlock("1234").check());
+    EXPECT_EQ(session.attempts_left(), 3u);
+
+    // Session ends after too many wrong PINs.
+    for (int i = 0; i < 3; ++i) EXPECT_FALSE(session.unlock("0000").check());
+    EXPECT_FALSE(session.active());
+    EXPECT_EQ(session.attempts_left(), 0u);
+    EXPECT_FALSE(session.unlock("1234").check());
+
+    // Timeout.
+    electronpass::QuickUnlock expired(key, "1234", std::chrono::seconds(0));
+    EXPECT_FALSE(expired.active());
+    EXPECT_EQ(expired.attempts_left(), 0u);
+    EXPECT_FALSE(expired.lock_if_expired());
+    EXPECT_FALSE(expired.unlock("1234").check());
+
+    electronpass::QuickUnlock locked(key, "1234");
+    locked.lock();
+    EXPECT_FALSE(locked.unlock("1234").check());
+
+    electronpass::QuickUnlock moved = std::move(locked);
+    moved = electronpass::QuickUnlock(key, "4321");
+    EXPECT_TRUE(moved.unlock("4321").check());
+}
+
+TEST(CryptoTest, KdfParamsTest) {
+    electronpass::KdfParams legacy = electronpass::KdfParams::legacy();
+    EXPECT_TRUE(legacy.valid());
+    EXPECT_EQ(legacy.algorithm, electronpass::KdfParams::Algorithm::SCRYPT);
+    EXPECT_TRUE(electronpass::Crypto("password").kdf_params() == legacy);
+
+    electronpass::KdfParams params1 = electronpass::KdfParams::generate();
+    electronpass::KdfParams params2 = electronpass::KdfParams::generate();
+    EXPECT_TRUE(params1.valid());
+    EXPECT_EQ(params1.algorithm, electronpass::KdfParams::Algorithm::ARGON2ID);
+    // Salt is random.
+    EXPECT_TRUE(params1 != params2);
+
+    electronpass::Crypto c1("password", params1);
+    electronpass::Crypto c2("password", params2);
+    electronpass::Crypto c3(electronpass::Crypto::derive_key("password", params1));
+    ASSERT_TRUE(c1.check() && c2.check() && c3.check());
+    EXPECT_TRUE(c3.kdf_params() == params1);
+
+    bool ok = false;
+    const std::string enc = c1.encrypt("Hello, World!", ok);
+    EXPECT_EQ(c3.decrypt(enc, ok), "Hello, World!");
+    EXPECT_TRUE(ok);
+    // Different salt gives different key.
+    EXPECT_EQ(c2.decrypt(enc, ok), "");
+    EXPECT_FALSE(ok);
+
+    // Invalid parameters.
+    electronpass::KdfParams invalid = params1;
+    invalid.memlimit = static_cast<uint64_t>(1) << 40;
+    EXPECT_FALSE(invalid.valid());
+    EXPECT_FALSE(electronpass::Crypto("password", invalid).check());
+    invalid = params1;
+    invalid.salt = "salt";
+    EXPECT_FALSE(invalid.valid());
+    EXPECT_FALSE(electronpass::Crypto::derive_key("password", invalid).check());
+}
+
+TEST(CryptoTest, CalibrateKdfTest) {
+    const uint64_t max_mem = 16 * 1024 * 1024;
+    electronpass::KdfParams params = electronpass::Crypto::calibrate_kdf(100, max_mem);
+    ASSERT_TRUE(params.valid());
+    EXPECT_EQ(params.algorithm, electronpass::KdfParams::Algorithm::ARGON2ID);
+    EXPECT_LE(params.memlimit, max_mem);
+
+    electronpass::Crypto c("password", params);
+    EXPECT_TRUE(c.check());
+
+    // Very short target still gives usable parameters.
+    params = electronpass::Crypto::calibrate_kdf(0, max_mem);
+    EXPECT_TRUE(params.valid());
+    EXPECT_EQ(params.opslimit, static_cast<uint64_t>(crypto_pwhash_OPSLIMIT_MIN));
+}
+
+#ifdef __linux__
+TEST(CryptoTest, CalibrateKdfLowMemoryTest) {
+    // Process, which can't allocate max_mem, still gets usable parameters with less memory.
+    const uint64_t max_mem = 1024 * 1024 * 1024;
+    EXPECT_EXIT({
+        std::ifstream statm("/proc/self/statm");
+        unsigned long pages = 0;
+        statm >> pages;
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = pages * sysconf(_SC_PAGESIZE) + 64 * 1024 * 1024;
+        if (setrlimit(RLIMIT_AS, &limit) != 0) std::exit(2);
+
+        electronpass::KdfParams params = electronpass::Crypto::calibrate_kdf(10000, max_mem);
+        std::exit(params.valid() && params.memlimit < max_mem / 8 ? 0 : 1);
+    }, ::testing::ExitedWithCode(0), "");
+}
+#endif
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+#include <thread>
+#include <string>
+
+#include "random.hpp"
+#include "crypto.hpp"
+
+TEST(RandomTest, BytesTest) {
+    // Short and long outputs, also ones that cross buffer boundaries. Outputs are long enough, that they don't repeat.
+    std::set<std::string> outputs;
+    for (size_t len : {8, 16, 100, 1000, 5000, 100000}) {
+        for (int i = 0; i < 10; ++i) {
+            std::string output(len, '\0');
+            electronpass::Random::bytes(&output[0], len);
+            outputs.insert(output);
+        }
+    }
+    EXPECT_EQ(outputs.size(), 60u);
+
+    // Long output is not constant.
+    std::string output(100000, '\0');
+    electronpass::Random::bytes(&output[0], output.size());
+    std::vector<int> counts(256, 0);
+    for (char c : output) ++counts[static_cast<unsigned char>(c)];
+    for (int count : counts) {
+        EXPECT_GT(count, 250);
+        EXPECT_LT(count, 550);
+    }
+}
+
+TEST(RandomTest, UniformTest) {
+    EXPECT_EQ(electronpass::Random::uniform(0), 0u);
+    EXPECT_EQ(electronpass::Random::uniform(1), 0u);
+
+    const uint32_t bound = 10;
+    std::vector<int> counts(bound, 0);
+    for (int i = 0; i < 100000; ++i) {
+        const uint32_t value = electronpass::Random::uniform(bound);
+        ASSERT_LT(value, bound);
+        ++counts[value];
+    }
+    for (int count : counts) {
+        EXPECT_GT(count, 9000);
+        EXPECT_LT(count, 11000);
+    }
+
+    // Large bounds, where rejection is most likely.
+    const uint32_t large = 0x80000001u;
+    for (int i = 0; i < 1000; ++i) EXPECT_LT(electronpass::Random::uniform(large), large);
+}
+
+TEST(RandomTest, ThreadsTest) {
+    // Each thread has its own generator with its own seed.
+    const int thread_count = 4;
+    std::vector<uint64_t> values(thread_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&values, t]() {
+            values[t] = electronpass::Random::uint64();
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    EXPECT_EQ(std::set<uint64_t>(values.begin(), values.end()).size(), static_cast<size_t>(thread_count));
+}
+
+TEST(RandomTest, UuidTest) {
+    std::set<std::string> ids;
+    for (int i = 0; i < 1000; ++i) {
+        const std::string id = electronpass::Crypto::generate_uuid();
+        EXPECT_EQ(id.size(), 32u);
+        ids.insert(id);
+    }
+    EXPECT_EQ(ids.size(), 1000u);
+}
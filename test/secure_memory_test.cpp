@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "secure_memory.hpp"
+
+TEST(SecureMemoryTest, AllocationTest) {
+    electronpass::SecureArena& arena = electronpass::SecureArena::instance();
+    const size_t allocated = arena.allocated_bytes();
+
+    std::vector<void *> blocks;
+    for (size_t size : {size_t(0), size_t(1), size_t(16), size_t(17), size_t(1000), size_t(4096),
+                        electronpass::SecureArena::MAX_BLOCK_BYTES, electronpass::SecureArena::MAX_BLOCK_BYTES + 1,
+                        size_t(5 * 1024 * 1024)}) {
+        unsigned char *p = static_cast<unsigned char *>(arena.allocate(size));
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+        std::fill(p, p + size, 0xab);
+        blocks.push_back(p);
+    }
+    EXPECT_GT(arena.allocated_bytes(), allocated);
+
+    const size_t sizes[] = {0, 1, 16, 17, 1000, 4096, electronpass::SecureArena::MAX_BLOCK_BYTES,
+                            electronpass::SecureArena::MAX_BLOCK_BYTES + 1, 5 * 1024 * 1024};
+    for (size_t i = 0; i < blocks.size(); ++i) arena.deallocate(blocks[i], sizes[i]);
+    EXPECT_EQ(arena.allocated_bytes(), allocated);
+
+    // Freed block is wiped and reused.
+    unsigned char *p = static_cast<unsigned char *>(arena.allocate(1000));
+    EXPECT_EQ(std::count(p, p + 1000, 0), 1000);
+    arena.deallocate(p, 1000);
+}
+
+TEST(SecureMemoryTest, RegionReuseTest) {
+    electronpass::SecureArena& arena = electronpass::SecureArena::instance();
+
+    // Allocating and freeing the same amount of memory many times doesn't allocate new regions.
+    for (int i = 0; i < 10; ++i) {
+        electronpass::SecureString s(100000, 'a');
+        electronpass::SecureBuffer b(3000);
+    }
+    const size_t regions = arena.regions();
+    for (int i = 0; i < 1000; ++i) {
+        electronpass::SecureString s(100000, 'a');
+        electronpass::SecureBuffer b(3000);
+    }
+    EXPECT_EQ(arena.regions(), regions);
+}
+
+TEST(SecureMemoryTest, SecureStringTest) {
+    electronpass::SecureString s = "secret";
+    s += " value";
+    EXPECT_EQ(s, "secret value");
+    EXPECT_EQ(std::string(s.begin(), s.end()), "secret value");
+
+    std::vector<electronpass::SecureString> strings;
+    for (int i = 0; i < 1000; ++i) strings.push_back(electronpass::SecureString(i, 'x'));
+    for (int i = 0; i < 1000; ++i) EXPECT_EQ(strings[i].size(), static_cast<size_t>(i));
+}
+
+TEST(SecureMemoryTest, WipeTest) {
+    // Short string, which is stored inside the string object.
+    electronpass::SecureString s = "hunter2";
+    const char *storage = s.data();
+    const size_t capacity = s.capacity();
+    electronpass::wipe(s);
+    EXPECT_TRUE(s.empty());
+    EXPECT_EQ(s.data(), storage);
+    for (size_t i = 0; i < capacity; ++i) EXPECT_EQ(storage[i], 0);
+
+    electronpass::SecureString long_string(1000, 'x');
+    electronpass::wipe(long_string);
+    EXPECT_TRUE(long_string.empty());
+}
+
+TEST(SecureMemoryTest, ThreadsTest) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 1000; ++i) {
+                electronpass::SecureString s((i * 37 + t) % 2000, 'a' + t);
+                EXPECT_EQ(std::count(s.begin(), s.end(), 'a' + t), static_cast<long>(s.size()));
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
 
 #include "wallet.hpp"
 #include "serialization.hpp"
@@ -22,12 +25,79 @@ electronpass::Wallet test_wallet() {
     return wallet;
 }
 
+// Binary header starts with magic bytes (4), version (2), timestamp (8), key derivation algorithm (1), opslimit (8),
+// memlimit (8) and salt length (1), followed by salt, cipher and flags.
+#define kHeaderSaltOffset 32
+
+size_t cipher_offset(const std::string& data) {
+    return kHeaderSaltOffset + static_cast<unsigned char>(data[kHeaderSaltOffset - 1]);
+}
+
+size_t flags_offset(const std::string& data) {
+    return cipher_offset(data) + 1;
+}
+
 TEST(SerializationTest, SerializationTest) {
     std::string json = electronpass::serialization::serialize(test_wallet());
     std::string json_string = "{\"items\":{\"YTBZGOOr/w13Vef8zFkm+YHGsutFGzSp\":{\"fields\":[{\"name\":\"Username\",\"sensitive\":false,\"type\":\"username\",\"value\":\"open_user\"},{\"name\":\"Password\",\"sensitive\":true,\"type\":\"password\",\"value\":\"secret_pa55\"}],\"last_edited\":1493189705,\"name\":\"Google\"},\"epW6aIyR6eBLmyQkgYG/KIDKWr0w0vba\":{\"fields\":[{\"name\":\"E-mail\",\"sensitive\":false,\"type\":\"email\",\"value\":\"electron.pass@mail.com\"},{\"name\":\"Password\",\"sensitive\":true,\"type\":\"password\",\"value\":\"reallynotsecurepass123\"}],\"last_edited\":1493189650,\"name\":\"Google\"}}}";
     EXPECT_EQ(json, json_string);
 }
 
+// Serializes wallet with jsoncpp, like serialize() did before it wrote JSON directly.
+std::string jsoncpp_serialize(const electronpass::Wallet& wallet) {
+    Json::Value root;
+    root["items"] = Json::Value();
+    for (std::string id : wallet.get_ids()) {
+        electronpass::Wallet::Item item = wallet[id];
+        Json::Value json_item;
+        json_item["name"] = item.name;
+        json_item["last_edited"] = item.last_edited;
+        Json::Value json_fields;
+        for (unsigned int j = 0; j < item.fields.size(); ++j) {
+            Json::Value field;
+            field["name"] = item.fields[j].name;
+            field["type"] = electronpass::Wallet::field_type_to_string(item.fields[j].field_type);
+            field["value"] = Json::Value(item.fields[j].value.data(), item.fields[j].value.data() + item.fields[j].value.size());
+            field["sensitive"] = item.fields[j].sensitive;
+            json_fields[j] = field;
+        }
+        json_item["fields"] = json_fields;
+        root["items"][id] = json_item;
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder.settings_["indentation"] = "";
+    return Json::writeString(builder, root);
+}
+
+TEST(SerializationTest, JsonWriterTest) {
+    std::string special = "quote\" backslash\\ slash/ \b\f\n\r\t \x01\x1f\x7f caf\xc3\xa9 ";
+    special.push_back('\0');
+    special += "end";
+
+    std::map<std::string, electronpass::Wallet::Item> items;
+    for (int i = 0; i < 50; ++i) {
+        std::string id = i % 3 == 0 ? "id" + std::to_string(i) : electronpass::ItemId::generate().to_string();
+        if (i == 1) id = special;
+        electronpass::Wallet::Item item(i % 2 ? special : "Item " + std::to_string(i), id,
+                                        static_cast<uint64_t>(i) * 1000000007ULL);
+        if (i == 2) item.last_edited = 18446744073709551615ULL;
+        for (int j = 0; j < i % 4; ++j) {
+            item.fields.push_back(electronpass::Wallet::Field(j ? "Name" : special, j % 2 ? special : "value",
+                                                              static_cast<electronpass::Wallet::FieldType>(j + i % 5),
+                                                              j % 2 == 0));
+        }
+        items[id] = item;
+    }
+    electronpass::Wallet wallet(items, 1493189805);
+
+    EXPECT_EQ(electronpass::serialization::serialize(wallet), jsoncpp_serialize(wallet));
+    EXPECT_EQ(electronpass::serialization::serialize(test_wallet()), jsoncpp_serialize(test_wallet()));
+
+    electronpass::Wallet wallet2 = electronpass::serialization::deserialize(electronpass::serialization::serialize(wallet));
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet));
+}
+
 TEST(SerializationTest, EmptySerializationTest) {
     std::string json = electronpass::serialization::serialize(electronpass::Wallet());
     EXPECT_EQ(json, "{\"items\":null}");
@@ -62,6 +132,40 @@ TEST(SerializationTest, EmptyDeserializationTest) {
     EXPECT_EQ(wallet.size(), static_cast<unsigned int>(0));
 }
 
+TEST(SerializationTest, StreamingDeserializationTest) {
+    // Unknown keys and values of unexpected types are ignored, duplicate items replace earlier ones.
+    std::string json = "{\"version\":[1,{\"items\":{}}],\"items\":{"
+                       "\"id1\":{\"name\":\"old\",\"fields\":[]},"
+                       "\"id2\":{\"name\":\"caf\\u00e9 \\\"\\ud83d\\ude00\\\"\",\"last_edited\":1.5e9,\"extra\":{\"name\":\"x\"},"
+                       "\"fields\":[{\"name\":\"Pin\",\"type\":\"pin\",\"sensitive\":true,\"value\":\"12\\n34\"},"
+                       "{\"name\":5,\"type\":\"unknown\",\"value\":null}]},"
+                       "\"id1\":{\"name\":\"new\",\"last_edited\":-1}}}";
+    electronpass::Wallet wallet = electronpass::serialization::deserialize(json);
+    ASSERT_EQ(wallet.size(), static_cast<unsigned long>(2));
+
+    electronpass::Wallet::Item item1 = wallet["id1"];
+    EXPECT_EQ(item1.name, "new");
+    EXPECT_NE(item1.last_edited, static_cast<uint64_t>(0));
+    EXPECT_EQ(item1.size(), static_cast<unsigned long>(0));
+
+    electronpass::Wallet::Item item2 = wallet["id2"];
+    EXPECT_EQ(item2.name, "caf\xc3\xa9 \"\xf0\x9f\x98\x80\"");
+    EXPECT_EQ(item2.last_edited, static_cast<uint64_t>(1500000000));
+    ASSERT_EQ(item2.size(), static_cast<unsigned long>(2));
+    EXPECT_EQ(item2[0].name, "Pin");
+    EXPECT_EQ(item2[0].field_type, electronpass::Wallet::FieldType::PIN);
+    EXPECT_TRUE(item2[0].sensitive);
+    EXPECT_EQ(item2[0].value, "12\n34");
+    EXPECT_EQ(item2[1].name, "");
+    EXPECT_EQ(item2[1].field_type, electronpass::Wallet::FieldType::UNDEFINED);
+    EXPECT_FALSE(item2[1].sensitive);
+    EXPECT_EQ(item2[1].value, "");
+
+    // Invalid JSON gives empty wallet.
+    EXPECT_EQ(electronpass::serialization::deserialize("{\"items\":{\"id1\":{}}").size(), static_cast<unsigned long>(0));
+    EXPECT_EQ(electronpass::serialization::deserialize("").size(), static_cast<unsigned long>(0));
+}
+
 TEST(SerializationTest, LoadSaveTest) {
     electronpass::Crypto crypto("password");
     electronpass::Wallet wallet1 = test_wallet();
@@ -91,6 +195,521 @@ TEST(SerializationTest, LoadSaveTest) {
     }
 }
 
+TEST(SerializationTest, StreamLoadSaveTest) {
+    electronpass::Crypto crypto("password");
+    electronpass::Wallet wallet1 = test_wallet();
+
+    std::stringstream stream;
+    int error = -1;
+    electronpass::serialization::save(wallet1, crypto, stream, error);
+    EXPECT_EQ(error, 0);
+
+    const std::string data = stream.str();
+    EXPECT_EQ(data.substr(0, 4), "EPWL");
+
+    int error2 = -1;
+    electronpass::Wallet wallet2 = electronpass::serialization::load(stream, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(wallet1.timestamp, wallet2.timestamp);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    // Wrong password.
+    std::istringstream in(data);
+    electronpass::serialization::load(in, electronpass::Crypto("Password"), error2);
+    EXPECT_EQ(error2, 4);
+
+    // Unsupported version.
+    std::string data2 = data;
+    data2[4] = 9;
+    std::istringstream in2(data2);
+    electronpass::serialization::load(in2, crypto, error2);
+    EXPECT_EQ(error2, 2);
+
+    // Wallets saved to a string can also be loaded from a stream.
+    std::istringstream in3(electronpass::serialization::save(wallet1, crypto, error));
+    wallet2 = electronpass::serialization::load(in3, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+}
+
+TEST(SerializationTest, CipherTest) {
+    electronpass::Crypto crypto("password");
+    electronpass::Wallet wallet1 = test_wallet();
+
+    const electronpass::Cipher ciphers[] = {electronpass::Cipher::CHACHA20_POLY1305,
+                                            electronpass::Cipher::XCHACHA20_POLY1305,
+                                            electronpass::Cipher::AES256_GCM};
+    for (electronpass::Cipher cipher : ciphers) {
+        if (!crypto.set_cipher(cipher)) continue;
+
+        int error = -1;
+        std::string data = electronpass::serialization::save(wallet1, crypto, error);
+        EXPECT_EQ(error, 0);
+
+        // Wallet can be opened with any cipher set on crypto.
+        int error2 = -1;
+        electronpass::Wallet wallet2 = electronpass::serialization::load(data, electronpass::Crypto("password"), error2);
+        EXPECT_EQ(error2, 0);
+        EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+        // Unknown cipher.
+        EXPECT_EQ(data[cipher_offset(data)], static_cast<char>(cipher));
+        data[cipher_offset(data)] = 9;
+        electronpass::serialization::load(data, crypto, error2);
+        EXPECT_EQ(error2, 2);
+    }
+}
+
+TEST(SerializationTest, DefaultCipherTest) {
+    electronpass::Crypto crypto("password");
+    int error = -1, error2 = -1;
+    const std::string data = electronpass::serialization::save(test_wallet(), crypto, error);
+    EXPECT_EQ(error, 0);
+
+    // Default cipher doesn't need hardware AES, so wallet can be opened on every device.
+    const electronpass::Cipher cipher = static_cast<electronpass::Cipher>(data[cipher_offset(data)]);
+    EXPECT_EQ(cipher, electronpass::Cipher::XCHACHA20_POLY1305);
+    EXPECT_TRUE(electronpass::Crypto::cipher_available(cipher));
+    electronpass::Wallet wallet = electronpass::serialization::load(data, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet), electronpass::serialization::serialize(test_wallet()));
+
+    // AES-256-GCM is only used, if app opts in on a device, where it is available.
+    const bool aes = electronpass::Crypto::cipher_available(electronpass::Cipher::AES256_GCM);
+    EXPECT_EQ(crypto.set_cipher(electronpass::Cipher::AES256_GCM), aes);
+    const std::string aes_data = electronpass::serialization::save(test_wallet(), crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(static_cast<electronpass::Cipher>(aes_data[cipher_offset(aes_data)]),
+              aes ? electronpass::Cipher::AES256_GCM : electronpass::Cipher::XCHACHA20_POLY1305);
+
+    // Devices without hardware AES reject AES-256-GCM wallets instead of failing to decrypt them.
+    if (!aes) {
+        std::string changed = data;
+        changed[cipher_offset(changed)] = static_cast<char>(electronpass::Cipher::AES256_GCM);
+        electronpass::serialization::load(changed, crypto, error2);
+        EXPECT_EQ(error2, 2);
+    }
+}
+
+TEST(SerializationTest, BinaryHeaderTest) {
+    electronpass::Crypto crypto("password");
+    int error = -1;
+    const std::string data = electronpass::serialization::save(test_wallet(), crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(data.substr(0, 4), "EPWL");
+    EXPECT_EQ(data[4], 6);
+
+    // Header is authenticated, so changing timestamp should fail decryption.
+    std::string changed = data;
+    changed[6] ^= 1;
+    electronpass::serialization::load(changed, crypto, error);
+    EXPECT_EQ(error, 1);
+
+    // Truncated header.
+    electronpass::serialization::load(data.substr(0, 20), crypto, error);
+    EXPECT_EQ(error, 2);
+
+    // Only version 6 binary wallets are supported.
+    for (char version = 1; version < 6; ++version) {
+        changed = data;
+        changed[4] = version;
+        electronpass::serialization::load(changed, crypto, error);
+        EXPECT_EQ(error, 2);
+    }
+}
+
+TEST(SerializationTest, PayloadLoadSaveTest) {
+    electronpass::Crypto crypto("password");
+    std::string name("name\0with\nnull", 15);
+
+    std::map<std::string, electronpass::Wallet::Item> items;
+    for (std::string id : {"YTBZGOOr/w13Vef8zFkm+YHGsutFGzSp", "AAAAAAAAAAAAAAAAAAAAAA==", "id1",
+                           "text id, which is longer than 24 bytes"}) {
+        electronpass::Wallet::Item item(name, id, 18446744073709551615ULL);
+        items[id] = item;
+    }
+    for (int type = 0; type <= static_cast<int>(electronpass::Wallet::FieldType::UNDEFINED); ++type) {
+        items["id1"].fields.push_back(electronpass::Wallet::Field(name, std::string(200 * type, 'v'),
+                                                                  static_cast<electronpass::Wallet::FieldType>(type),
+                                                                  type % 2 == 0));
+    }
+    electronpass::Wallet wallet1(items, 1493189805);
+
+    int error = -1, error2 = -1;
+    const std::string data = electronpass::serialization::save(wallet1, crypto, error);
+    EXPECT_EQ(error, 0);
+    electronpass::Wallet wallet2 = electronpass::serialization::load(data, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(wallet2.timestamp, wallet1.timestamp);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet1));
+    EXPECT_EQ(wallet2["id1"].name, name);
+    EXPECT_EQ(wallet2["id1"].last_edited, 18446744073709551615ULL);
+
+    std::stringstream stream;
+    electronpass::serialization::save(wallet1, crypto, stream, error);
+    EXPECT_EQ(error, 0);
+    wallet2 = electronpass::serialization::load(stream, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet1));
+
+    // Binary payload is smaller than JSON.
+    EXPECT_LT(electronpass::serialization::save(test_wallet(), crypto, error).size(),
+              electronpass::serialization::serialize(test_wallet()).size());
+}
+
+TEST(SerializationTest, SegmentedLoadSaveTest) {
+    electronpass::Crypto crypto("password");
+    electronpass::Wallet wallet1 = test_wallet();
+
+    // Wallet larger than one segment.
+    electronpass::Wallet::Item notes("Notes", "id1", 1493189705);
+    notes.fields = {electronpass::Wallet::Field("Note", std::string(3 * electronpass::Crypto::SEGMENT_BYTES, 'n'),
+                                                electronpass::Wallet::FieldType::OTHER, false)};
+    wallet1.add_item(notes);
+
+    int error = -1;
+    const std::string data = electronpass::serialization::save(wallet1, crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(data[4], 6);
+    EXPECT_EQ(data[flags_offset(data)], 1);  // Segmented flag.
+
+    int error2 = -1;
+    electronpass::Wallet wallet2 = electronpass::serialization::load(data, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    std::istringstream in(data);
+    wallet2 = electronpass::serialization::load(in, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    // Truncated wallet.
+    electronpass::serialization::load(data.substr(0, data.size() - 100), crypto, error2);
+    EXPECT_EQ(error2, 1);
+    electronpass::serialization::load(data.substr(0, data.size() - electronpass::Crypto::SEGMENT_BYTES), crypto,
+                                      error2);
+    EXPECT_EQ(error2, 1);
+}
+
+TEST(SerializationTest, CompressionTest) {
+    using electronpass::serialization::Compression;
+    electronpass::Crypto crypto("password");
+    electronpass::Wallet wallet1 = test_wallet();
+    for (int i = 0; i < 200; ++i) {
+        electronpass::Wallet::Item item("Item " + std::to_string(i), "item" + std::to_string(i), 1493189705 + i);
+        item.fields = {electronpass::Wallet::Field("Username", "user" + std::to_string(i) + "@example.com",
+                                                   electronpass::Wallet::FieldType::USERNAME, false),
+                       electronpass::Wallet::Field("Password", "password" + std::to_string(i),
+                                                   electronpass::Wallet::FieldType::PASSWORD, true)};
+        wallet1.add_item(item);
+    }
+    const std::string json = electronpass::serialization::serialize(wallet1);
+
+    EXPECT_TRUE(electronpass::serialization::compression_available(Compression::NONE));
+    EXPECT_TRUE(electronpass::serialization::compression_available(Compression::LZ));
+
+    int error = -1, error2 = -1;
+    // Wallets are not compressed by default.
+    const std::string uncompressed = electronpass::serialization::save(wallet1, crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(uncompressed[flags_offset(uncompressed)], 0);
+
+    for (Compression compression : {Compression::LZ, Compression::ZLIB}) {
+        const uint8_t flag = compression == Compression::LZ ? 2 : 4;
+        if (!electronpass::serialization::compression_available(compression)) {
+            electronpass::serialization::save(wallet1, crypto, error, compression);
+            EXPECT_EQ(error, 2);
+            continue;
+        }
+
+        const std::string data = electronpass::serialization::save(wallet1, crypto, error, compression);
+        EXPECT_EQ(error, 0);
+        EXPECT_EQ(data[flags_offset(data)], flag);
+        EXPECT_LT(data.size(), uncompressed.size());
+        electronpass::Wallet wallet2 = electronpass::serialization::load(data, crypto, error2);
+        EXPECT_EQ(error2, 0);
+        EXPECT_EQ(electronpass::serialization::serialize(wallet2), json);
+
+        std::stringstream stream;
+        electronpass::serialization::save(wallet1, crypto, stream, error, compression);
+        EXPECT_EQ(error, 0);
+        EXPECT_EQ(stream.str()[flags_offset(stream.str())], flag);
+        wallet2 = electronpass::serialization::load(stream, crypto, error2);
+        EXPECT_EQ(error2, 0);
+        EXPECT_EQ(electronpass::serialization::serialize(wallet2), json);
+
+        // Compression flags are authenticated.
+        std::string changed = data;
+        changed[flags_offset(changed)] = 0;
+        electronpass::serialization::load(changed, crypto, error2);
+        EXPECT_EQ(error2, 1);
+        changed[flags_offset(changed)] = 6;
+        electronpass::serialization::load(changed, crypto, error2);
+        EXPECT_EQ(error2, 2);
+    }
+
+    // Payload, which doesn't get smaller, is saved uncompressed.
+    electronpass::Wallet empty;
+    const std::string data = electronpass::serialization::save(empty, crypto, error, Compression::LZ);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(data[flags_offset(data)], 0);
+    electronpass::serialization::load(data, crypto, error2);
+    EXPECT_EQ(error2, 0);
+
+    // Segmented wallet is split after compression.
+    electronpass::Wallet::Item notes("Notes", "notes", 1493189705);
+    std::string note;
+    for (size_t i = 0; note.size() < 2 * electronpass::Crypto::SEGMENT_BYTES; ++i) note += std::to_string(i * i);
+    notes.fields = {electronpass::Wallet::Field("Note", note, electronpass::Wallet::FieldType::OTHER, false)};
+    wallet1.add_item(notes);
+    const std::string segmented = electronpass::serialization::save(wallet1, crypto, error, Compression::LZ);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(segmented[flags_offset(segmented)], 3);
+    electronpass::Wallet wallet2 = electronpass::serialization::load(segmented, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(std::string(wallet2["notes"].fields[0].value.c_str()), note);
+}
+
+TEST(SerializationTest, FileLoadSaveTest) {
+    electronpass::Crypto crypto("password");
+    const std::string path = "serialization_file_test.epwl";
+    std::remove(path.c_str());
+
+    int error = -1, error2 = -1;
+    electronpass::serialization::load_file(path, crypto, error);
+    EXPECT_EQ(error, 5);
+
+    electronpass::Wallet wallet1 = test_wallet();
+    electronpass::serialization::save_file(wallet1, crypto, path, error);
+    EXPECT_EQ(error, 0);
+    electronpass::Wallet wallet2 = electronpass::serialization::load_file(path, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(wallet2.timestamp, wallet1.timestamp);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet1));
+
+    // Saving again replaces the file.
+    wallet1.delete_item("id1");
+    electronpass::serialization::save_file(wallet1, crypto, path, error);
+    EXPECT_EQ(error, 0);
+    wallet2 = electronpass::serialization::load_file(path, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet1));
+
+    // File, that can't be written, doesn't change anything.
+    electronpass::serialization::save_file(wallet1, crypto, "missing directory/wallet.epwl", error);
+    EXPECT_EQ(error, 5);
+    electronpass::serialization::save_file(wallet1, crypto, path, error,
+                                           static_cast<electronpass::serialization::Compression>(100));
+    EXPECT_EQ(error, 2);
+    electronpass::serialization::load_file(path, crypto, error2);
+    EXPECT_EQ(error2, 0);
+
+    // Legacy JSON wallets and empty files are read too.
+    bool success;
+    const std::string legacy = "{\"data\":\"" + crypto.encrypt(electronpass::serialization::serialize(wallet1), success) +
+                               "\",\"timestamp\":1493189705,\"version\":0}";
+    ASSERT_TRUE(success);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << legacy;
+    wallet2 = electronpass::serialization::load_file(path, crypto, error2);
+    EXPECT_EQ(error2, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet2), electronpass::serialization::serialize(wallet1));
+
+    std::ofstream(path, std::ios::trunc);
+    electronpass::serialization::load_file(path, crypto, error2);
+    electronpass::serialization::load("", crypto, error);
+    EXPECT_EQ(error2, error);
+
+    std::remove(path.c_str());
+}
+
+TEST(SerializationTest, KdfParamsTest) {
+    electronpass::KdfParams params = electronpass::KdfParams::generate();
+    electronpass::Crypto crypto("password", params);
+
+    int error = -1;
+    const std::string data = electronpass::serialization::save(test_wallet(), crypto, error);
+    EXPECT_EQ(error, 0);
+
+    // Parameters are read from the header, even if data is not complete.
+    electronpass::KdfParams read = electronpass::serialization::kdf_params(data.substr(0, 140), error);
+    EXPECT_EQ(error, 0);
+    EXPECT_TRUE(read == params);
+
+    electronpass::Wallet wallet = electronpass::serialization::load(data, electronpass::Crypto("password", read), error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet), electronpass::serialization::serialize(test_wallet()));
+
+    // Crypto with different parameters.
+    electronpass::serialization::load(data, electronpass::Crypto("password"), error);
+    EXPECT_EQ(error, 3);
+
+    // Wrong password.
+    electronpass::serialization::load(data, electronpass::Crypto("Password", read), error);
+    EXPECT_EQ(error, 4);
+
+    // Parameters with too much memory are rejected.
+    std::string changed = data;
+    changed[30] = 0x7f;
+    electronpass::serialization::kdf_params(changed, error);
+    EXPECT_EQ(error, 2);
+    electronpass::serialization::load(changed, crypto, error);
+    EXPECT_EQ(error, 2);
+
+    // Legacy wallets use legacy parameters.
+    bool success;
+    std::string json = "{\"data\":\"" + crypto.encrypt("{}", success) + "\",\"timestamp\":1,\"version\":0}";
+    EXPECT_TRUE(electronpass::serialization::kdf_params(json, error) == electronpass::KdfParams::legacy());
+    EXPECT_EQ(error, 0);
+}
+
+TEST(SerializationTest, LegacyLoadTest) {
+    electronpass::Crypto crypto("password");
+    bool success;
+    std::string json = "{\"data\":\"" + crypto.encrypt(electronpass::serialization::serialize(test_wallet()), success) +
+                       "\",\"timestamp\":1493189805,\"version\":0}";
+    ASSERT_TRUE(success);
+
+    int error = -1;
+    electronpass::Wallet wallet = electronpass::serialization::load(json, crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(wallet.timestamp, static_cast<uint64_t>(1493189805));
+    EXPECT_EQ(electronpass::serialization::serialize(wallet), electronpass::serialization::serialize(test_wallet()));
+}
+
+TEST(SerializationTest, LegacyStreamLoadTest) {
+    electronpass::Crypto crypto("password");
+    electronpass::Wallet wallet1 = test_wallet();
+    // Values that need escaping in JSON.
+    electronpass::Wallet::Item item("Notes \"quoted\"", "id", 1493189705);
+    item.fields = {electronpass::Wallet::Field("Note", "line 1\nline 2\t\\ \xc5\xbe \xf0\x9f\x94\x91 \x01",
+                                               electronpass::Wallet::FieldType::OTHER, true)};
+    wallet1.add_item(item);
+    // Large value, which is read in many chunks.
+    electronpass::Wallet::Item large("Large", "large", 1493189705);
+    large.fields = {electronpass::Wallet::Field("Data", std::string(300000, 'x'),
+                                                electronpass::Wallet::FieldType::OTHER, false)};
+    wallet1.add_item(large);
+
+    bool success;
+    const std::string json = "{\"version\":0,\"data\":\"" +
+                             crypto.encrypt(electronpass::serialization::serialize(wallet1), success) +
+                             "\",\"timestamp\":1493189805}";
+    ASSERT_TRUE(success);
+
+    int error = -1;
+    std::istringstream in(json);
+    electronpass::Wallet wallet2 = electronpass::serialization::load(in, crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(wallet2.timestamp, static_cast<uint64_t>(1493189805));
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    // Wrong password and changed data.
+    std::istringstream in2(json);
+    wallet2 = electronpass::serialization::load(in2, electronpass::Crypto("Password"), error);
+    EXPECT_EQ(error, 1);
+    EXPECT_EQ(wallet2.size(), 0u);
+    EXPECT_EQ(wallet2.timestamp, static_cast<uint64_t>(1493189805));
+
+    std::string changed = json;
+    changed[json.size() / 2] = changed[json.size() / 2] == 'A' ? 'B' : 'A';
+    std::istringstream in3(changed);
+    wallet2 = electronpass::serialization::load(in3, crypto, error);
+    EXPECT_EQ(error, 1);
+    EXPECT_EQ(wallet2.size(), 0u);
+
+    // Truncated wallet.
+    std::istringstream in4(json.substr(0, json.size() / 2));
+    electronpass::serialization::load(in4, crypto, error);
+    EXPECT_EQ(error, 2);
+
+    // Missing data and other key derivation parameters.
+    std::istringstream in5("{\"version\":0,\"timestamp\":1}");
+    electronpass::serialization::load(in5, crypto, error);
+    EXPECT_EQ(error, 2);
+    std::istringstream in6(json);
+    electronpass::serialization::load(in6, electronpass::Crypto("password", electronpass::KdfParams::generate()),
+                                      error);
+    EXPECT_EQ(error, 3);
+}
+
+TEST(SerializationTest, WrongPasswordTest) {
+    electronpass::Crypto crypto("password");
+    int error = -1;
+    const std::string data = electronpass::serialization::save(test_wallet(), crypto, error);
+    EXPECT_EQ(error, 0);
+
+    // Wrong password is reported separately from corrupted wallet.
+    electronpass::serialization::load(data, electronpass::Crypto("Password"), error);
+    EXPECT_EQ(error, 4);
+
+    std::string corrupted = data;
+    corrupted[corrupted.size() - 1] ^= 1;
+    electronpass::serialization::load(corrupted, crypto, error);
+    EXPECT_EQ(error, 1);
+    electronpass::serialization::load(corrupted, electronpass::Crypto("Password"), error);
+    EXPECT_EQ(error, 4);
+
+    // Wrong password is detected from the header alone.
+    std::istringstream in(data.substr(0, 200));
+    electronpass::serialization::load(in, electronpass::Crypto("Password"), error);
+    EXPECT_EQ(error, 4);
+}
+
+TEST(SerializationTest, ChangePasswordTest) {
+    electronpass::Crypto old_crypto("password");
+    electronpass::Crypto new_crypto("new password", electronpass::KdfParams::generate());
+    electronpass::Wallet wallet1 = test_wallet();
+
+    int error = -1;
+    const std::string data = electronpass::serialization::save(wallet1, old_crypto, error);
+    EXPECT_EQ(error, 0);
+
+    const std::string changed = electronpass::serialization::change_password(data, old_crypto, new_crypto, error);
+    EXPECT_EQ(error, 0);
+
+    // Encrypted wallet after the header (122 bytes and salt) is not changed.
+    const size_t body = data.size() - 122 - static_cast<unsigned char>(data[kHeaderSaltOffset - 1]);
+    EXPECT_EQ(changed.substr(changed.size() - body), data.substr(data.size() - body));
+
+    electronpass::Wallet wallet2 = electronpass::serialization::load(changed, new_crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    electronpass::serialization::load(changed, old_crypto, error);
+    EXPECT_EQ(error, 3);
+    electronpass::serialization::load(changed, electronpass::Crypto("password", new_crypto.kdf_params()), error);
+    EXPECT_EQ(error, 4);
+
+    // Wrong old password.
+    electronpass::serialization::change_password(data, electronpass::Crypto("Password"), new_crypto, error);
+    EXPECT_EQ(error, 4);
+
+    // Wrapped key is authenticated.
+    std::string tampered = changed;
+    tampered[tampered.size() - body - 1] ^= 1;
+    electronpass::serialization::load(tampered, new_crypto, error);
+    EXPECT_EQ(error, 1);
+
+    // Wallets saved to a stream.
+    std::stringstream stream;
+    electronpass::serialization::save(wallet1, old_crypto, stream, error);
+    EXPECT_EQ(error, 0);
+    std::istringstream in(electronpass::serialization::change_password(stream.str(), old_crypto, new_crypto, error));
+    EXPECT_EQ(error, 0);
+    wallet2 = electronpass::serialization::load(in, new_crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+
+    // Legacy wallets are encrypted again.
+    bool success;
+    std::string json = "{\"data\":\"" + old_crypto.encrypt(electronpass::serialization::serialize(wallet1), success) +
+                       "\",\"timestamp\":1493189805,\"version\":0}";
+    wallet2 = electronpass::serialization::load(
+        electronpass::serialization::change_password(json, old_crypto, new_crypto, error), new_crypto, error);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(electronpass::serialization::serialize(wallet1), electronpass::serialization::serialize(wallet2));
+}
+
 TEST(SerializationTest, InvalidJSONTest) {
     std::string json = "\"\"";
     electronpass::Crypto crypto("");
@@ -98,3 +717,47 @@ TEST(SerializationTest, InvalidJSONTest) {
     electronpass::Wallet wallet = electronpass::serialization::load(json, crypto, error);
     EXPECT_EQ(error, 2);
 }
+
+TEST(SerializationTest, TopLevelLiteralTest) {
+    // JSON, which ends with a literal, is complete.
+    electronpass::Crypto crypto("password");
+    for (std::string literal : {"null", "true", "false", " null "}) {
+        bool success;
+        const std::string json = "{\"data\":\"" + crypto.encrypt(literal, success) +
+                                 "\",\"timestamp\":1493189805,\"version\":0}";
+        ASSERT_TRUE(success);
+
+        int error = -1;
+        electronpass::Wallet wallet = electronpass::serialization::load(json, crypto, error);
+        EXPECT_EQ(error, 0) << literal;
+        EXPECT_EQ(wallet.size(), 0u);
+    }
+
+    // Incomplete literal is not.
+    bool success;
+    const std::string json = "{\"data\":\"" + crypto.encrypt("nul", success) +
+                             "\",\"timestamp\":1493189805,\"version\":0}";
+    int error = -1;
+    electronpass::serialization::load(json, crypto, error);
+    EXPECT_EQ(error, 2);
+}
+
+TEST(SerializationTest, LongTokenTest) {
+    // Parser doesn't buffer unlimited numbers, literals or keys, so streamed wallets are loaded in bounded memory.
+    electronpass::Crypto crypto("password");
+    const std::string long_id(5000, 'a');
+    for (std::string json : {std::string(100000, 't'), "[" + std::string(100000, '1') + "]",
+                             "{\"items\":{\"" + long_id + "\":{}}}"}) {
+        bool success;
+        const std::string data = "{\"data\":\"" + crypto.encrypt(json, success) +
+                                 "\",\"timestamp\":1493189805,\"version\":0}";
+        ASSERT_TRUE(success);
+
+        int error = -1;
+        electronpass::serialization::load(data, crypto, error);
+        EXPECT_EQ(error, 2);
+        std::istringstream in(data);
+        electronpass::serialization::load(in, crypto, error);
+        EXPECT_EQ(error, 2);
+    }
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include "sharing.hpp"
+#include "serialization.hpp"
+
+namespace {
+    struct User {
+        std::string public_key;
+        electronpass::DerivedKey secret_key;
+
+        User(): public_key(electronpass::Crypto::PUBLIC_KEY_BYTES, '\0'),
+                secret_key{electronpass::Crypto::generate_key_pair(
+                    reinterpret_cast<unsigned char *>(&public_key[0]))} {}
+    };
+
+    std::vector<electronpass::Wallet::Item> shared_items() {
+        electronpass::Wallet::Item item1("Router", "router", 1493189705);
+        item1.fields = {electronpass::Wallet::Field("Password", "secret_pa55", electronpass::Wallet::FieldType::PASSWORD,
+                                                    true)};
+        electronpass::Wallet::Item item2("Server", "server", 1493189650);
+        item2.fields = {electronpass::Wallet::Field("Username", "admin", electronpass::Wallet::FieldType::USERNAME,
+                                                    false)};
+        return {item1, item2};
+    }
+
+    struct Sender {
+        std::string public_key;
+        electronpass::DerivedKey signing_key;
+
+        Sender(): public_key(electronpass::Crypto::SIGNING_PUBLIC_KEY_BYTES, '\0'),
+                  signing_key{electronpass::Crypto::generate_signing_key_pair(
+                      reinterpret_cast<unsigned char *>(&public_key[0]))} {}
+
+        // Replaces signature of the data, so changes are only detected by decryption.
+        std::string sign(std::string data) const {
+            const size_t signed_len = data.size() - electronpass::Crypto::SIGNATURE_BYTES;
+            electronpass::Crypto::sign(reinterpret_cast<const unsigned char *>(data.data()), signed_len, signing_key,
+                                       reinterpret_cast<unsigned char *>(&data[signed_len]));
+            return data;
+        }
+    };
+}
+
+TEST(SharingTest, ShareReceiveTest) {
+    Sender sender;
+    std::vector<User> users(20);
+    std::vector<std::string> public_keys;
+    for (const User& user : users) public_keys.push_back(user.public_key);
+
+    int error = -1;
+    const std::string data = electronpass::sharing::share(shared_items(), public_keys, sender.signing_key, error);
+    EXPECT_EQ(error, 0);
+
+    // Items are encrypted once, each recipient only adds a sealed key.
+    const std::string one = electronpass::sharing::share(shared_items(), {public_keys[0]}, sender.signing_key, error);
+    EXPECT_EQ(data.size() - one.size(), 19 * (8 + electronpass::Crypto::SEALED_KEY_BYTES));
+
+    const std::string expected = electronpass::serialization::serialize(electronpass::Wallet(
+        {{"router", shared_items()[0]}, {"server", shared_items()[1]}}));
+    for (const User& user : users) {
+        electronpass::Wallet wallet = electronpass::sharing::receive(data, user.public_key, user.secret_key,
+                                                                     sender.public_key, error);
+        EXPECT_EQ(error, 0);
+        EXPECT_EQ(electronpass::serialization::serialize(wallet), expected);
+    }
+}
+
+TEST(SharingTest, ErrorTest) {
+    Sender sender, other_sender;
+    User user, other;
+    int error = -1;
+    const std::string data = electronpass::sharing::share(shared_items(), {user.public_key}, sender.signing_key, error);
+    EXPECT_EQ(error, 0);
+
+    // Not a recipient.
+    electronpass::sharing::receive(data, other.public_key, other.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 4);
+
+    // Different sender, changed data and changed signature.
+    electronpass::sharing::receive(data, user.public_key, user.secret_key, other_sender.public_key, error);
+    EXPECT_EQ(error, 3);
+    std::string changed = data;
+    changed[changed.size() - electronpass::Crypto::SIGNATURE_BYTES - 1] ^= 1;
+    electronpass::sharing::receive(changed, user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 3);
+    changed = data;
+    changed[changed.size() - 1] ^= 1;
+    electronpass::sharing::receive(changed, user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 3);
+    // Signature only tells who signed the data, recipient decides which sender to trust.
+    electronpass::sharing::receive(other_sender.sign(data), user.public_key, user.secret_key, other_sender.public_key,
+                                   error);
+    EXPECT_EQ(error, 0);
+
+    // Changed items and changed list of recipients, signed again by the sender.
+    changed = data;
+    changed[changed.size() - electronpass::Crypto::SIGNATURE_BYTES - 1] ^= 1;
+    electronpass::sharing::receive(sender.sign(changed), user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 1);
+    changed = data;
+    changed[6] = 2;
+    electronpass::sharing::receive(sender.sign(changed), user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 1);
+    changed = data;
+    changed[10] ^= 1;
+    electronpass::sharing::receive(sender.sign(changed), user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 4);
+
+    // Unsupported version and cipher.
+    changed = data;
+    changed[4] = 9;
+    electronpass::sharing::receive(changed, user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 2);
+    changed = data;
+    changed[5] = 3;
+    electronpass::sharing::receive(changed, user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 2);
+
+    // Truncated data.
+    electronpass::sharing::receive(data.substr(0, 50), user.public_key, user.secret_key, sender.public_key, error);
+    EXPECT_EQ(error, 2);
+
+    // Invalid recipients.
+    electronpass::sharing::share(shared_items(), {}, sender.signing_key, error);
+    EXPECT_EQ(error, 2);
+    electronpass::sharing::share(shared_items(), {"short"}, sender.signing_key, error);
+    EXPECT_EQ(error, 2);
+}
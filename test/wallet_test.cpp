@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "wallet.hpp"
+#include <algorithm>
 
 TEST(WalletTest, ItemInit) {
     electronpass::Wallet::Item item;
@@ -60,3 +61,88 @@ TEST(WalletTest, Merge) {
     EXPECT_EQ(electronpass::Wallet::merge(wallet1, wallet2)["YTBZGOOr/w13Vef8zFkm+YHGsutFGzSp"].last_edited,
               static_cast<uint64_t>(1493189705));
 }
+
+TEST(WalletTest, ItemIdTest) {
+    // Ids, that are not canonical Base64, are kept as text.
+    for (std::string id : {"", "id", "id1", "YTBZGOOr/w13Vef8zFkm+YHGsutFGzSp", "YQ==", "YR==", "YTBZ====",
+                           "abc\n", "this is a text id, which is longer than 24 bytes", "AAAAAAAAAAAAAAAAAAAAAAAA",
+                           "YTBZGOOr/w13Vef8zFkm+YHGsutFGzSpYTBZ"}) {
+        electronpass::ItemId item_id(id);
+        EXPECT_EQ(item_id.to_string(), id);
+        EXPECT_EQ(item_id.empty(), id.empty());
+
+        electronpass::ItemId copy = item_id;
+        EXPECT_EQ(copy, item_id);
+        EXPECT_EQ(copy.hash(), item_id.hash());
+        electronpass::ItemId moved = std::move(copy);
+        EXPECT_EQ(moved.to_string(), id);
+    }
+
+    EXPECT_NE(electronpass::ItemId("YQ=="), electronpass::ItemId("YR=="));
+    EXPECT_NE(electronpass::ItemId("id1"), electronpass::ItemId("id2"));
+    EXPECT_TRUE(electronpass::ItemId("id1") < electronpass::ItemId("id2"));
+    EXPECT_FALSE(electronpass::ItemId("id1") < electronpass::ItemId("id1"));
+
+    electronpass::ItemId generated = electronpass::ItemId::generate();
+    EXPECT_EQ(generated.to_string().size(), static_cast<size_t>(32));
+    EXPECT_EQ(electronpass::ItemId(generated.to_string()), generated);
+    EXPECT_NE(electronpass::ItemId::generate(), generated);
+}
+
+TEST(WalletTest, LookupTest) {
+    electronpass::Wallet wallet;
+    std::vector<std::string> ids;
+    for (int i = 0; i < 1000; ++i) {
+        electronpass::Wallet::Item item(std::to_string(i), i % 2 ? electronpass::ItemId() : std::to_string(i));
+        ids.push_back(item.get_id());
+        EXPECT_TRUE(wallet.add_item(item));
+        EXPECT_FALSE(wallet.add_item(item));
+    }
+    EXPECT_EQ(wallet.size(), static_cast<unsigned long>(1000));
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(wallet[ids[i]].name, std::to_string(i));
+        EXPECT_EQ(wallet[electronpass::ItemId(ids[i])].get_id(), ids[i]);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(wallet.get_ids(), ids);
+    EXPECT_EQ(wallet.get_item_ids().size(), ids.size());
+
+    wallet.delete_item(ids[0]);
+    EXPECT_EQ(wallet.size(), static_cast<unsigned long>(999));
+    EXPECT_THROW(wallet[ids[0]], std::out_of_range);
+}
+
+TEST(WalletTest, FieldWipeTest) {
+    typedef electronpass::Wallet::Field Field;
+    const std::string password = "hunter2";
+
+    // Short value is stored inside the field, which is wiped when it is destroyed.
+    alignas(Field) unsigned char storage[sizeof(Field)];
+    Field *field = new (storage) Field("password", password, electronpass::Wallet::FieldType::PASSWORD, true);
+    const unsigned char *value = reinterpret_cast<const unsigned char *>(field->value.data());
+    field->~Field();
+    for (size_t i = 0; i < password.size(); ++i) EXPECT_EQ(value[i], 0);
+
+    // Moved from field is wiped too.
+    Field field1("password", password, electronpass::Wallet::FieldType::PASSWORD, true);
+    const char *value1 = field1.value.data();
+    Field field2(std::move(field1));
+    EXPECT_EQ(std::string(field2.value.c_str()), password);
+    for (size_t i = 0; i < password.size(); ++i) EXPECT_EQ(value1[i], 0);
+
+    Field field3;
+    const char *value2 = field2.value.data();
+    field3 = std::move(field2);
+    EXPECT_EQ(std::string(field3.value.c_str()), password);
+    for (size_t i = 0; i < password.size(); ++i) EXPECT_EQ(value2[i], 0);
+
+    // Assigned field wipes its old value.
+    const char *value3 = field3.value.data();
+    field3 = Field("pin", "1", electronpass::Wallet::FieldType::PIN, true);
+    EXPECT_EQ(std::string(field3.value.c_str()), "1");
+    if (field3.value.data() == value3) {
+        for (size_t i = 1; i < password.size(); ++i) EXPECT_EQ(value3[i], 0);
+    }
+}